@@ -1,22 +1,50 @@
 #include "EspSigK.h"
 
-#define SERIAL_DEBUG_MESSAGE_PREFIX "SigK: "
-#define JSON_DESERIALIZE_DELTA_SIZE 384
-#define JSON_DESERIALIZE_HTTP_RESPONSE_SIZE 384
+#include <sys/time.h>
+#include <time.h>
+
+// {updates: [{meta: [{path, value: {units, displayName, zones: [{lower, upper, state, message} * MAX_META_ZONES]}}]}]},
+// units, displayName and messages are copied from flash
+#define JSON_SERIALIZE_META_SIZE (JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(1) + 2 * JSON_OBJECT_SIZE(3) \
+                                  + JSON_ARRAY_SIZE(MAX_META_ZONES) + MAX_META_ZONES * JSON_OBJECT_SIZE(4) + META_FRAME_SIZE / 2)
+// {endpoints: {v1: {version, signalk-ws, signalk-http}}, server: {id}}
+#define JSON_SERIALIZE_ENDPOINTS_SIZE (JSON_OBJECT_SIZE(2) + JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(1))
+#ifndef HTTP_REQUEST_PAYLOAD_SIZE
+#define HTTP_REQUEST_PAYLOAD_SIZE 160
+#endif
+// An approved access request carries the token plus state, requestId, statusCode, href, permission,
+// expirationTime and ip, which take about 250 bytes
+#define HTTP_RESPONSE_ENVELOPE_SIZE 384
+#ifndef HTTP_RESPONSE_BODY_SIZE
+#define HTTP_RESPONSE_BODY_SIZE (SIGNALKAUTH_TOKEN_LENGTH + HTTP_RESPONSE_ENVELOPE_SIZE)
+#endif
+// filtered access request response: {state, href, accessRequest: {permission, token}}, strings stay in the body buffer
+#define JSON_DESERIALIZE_HTTP_RESPONSE_SIZE (JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(2))
 #define PREFERENCES_NAMESPACE "EspSigK"
+#define API_PATH "/signalk/v1/api"
+#define API_SELF_PATH API_PATH "/vessels/self"
+#define SIGNALK_API_VERSION "1.0.0"
+#define HTTP_CHUNK_SIZE 256
+
+static_assert(HTTP_RESPONSE_BODY_SIZE >= SIGNALKAUTH_TOKEN_LENGTH + HTTP_RESPONSE_ENVELOPE_SIZE,
+              "HTTP_RESPONSE_BODY_SIZE can't hold an approved access request with a SIGNALKAUTH_TOKEN_LENGTH token");
+static_assert(HTTP_REQUEST_BUFFER_SIZE + HTTP_RESPONSE_BODY_SIZE + sizeof(signalKAccessResponse)
+              + sizeof(StaticJsonDocument<JSON_DESERIALIZE_HTTP_RESPONSE_SIZE>) <= ESPSIGK_STACK_BUDGET,
+              "sendAccessRequest() buffers exceed ESPSIGK_STACK_BUDGET");
+static_assert(sizeof(StaticJsonDocument<JSON_SERIALIZE_META_SIZE>) + META_FRAME_SIZE <= ESPSIGK_STACK_BUDGET,
+              "sendMeta() buffers exceed ESPSIGK_STACK_BUDGET, lower MAX_META_ZONES or META_FRAME_SIZE");
 
 
 // Server variables
-ESP8266WebServer server(80);
+EspSigKWebServer server(80);
 websockets::WebsocketsClient webSocketClient;
 
 bool printDeltaSerial;
 bool printDebugSerial;
-    
-bool wsClientConnected;
 
+#if ESPSIGK_DELTA_PAGE
 // Simple web page to view deltas
-const char * EspSigKIndexContents = R"foo(
+static const char EspSigKIndexContents[] PROGMEM = R"foo(
 <html>
 <head>
   <title>Deltas</title>
@@ -54,12 +82,14 @@ const char * EspSigKIndexContents = R"foo(
 
   <p>
     <ul>
+      <li><a href="signalk/v1/api/vessels/self">Current values</a></li>
       <li><a href="reset_auth">Reset authentication tokens</a></li>
     </ul>
   </p>
 </body>
 </html>
 )foo";
+#endif
 
 // Response to SignalK authentication reset
 const char * EspSigKAuthResetContent = R"foo(
@@ -88,14 +118,33 @@ const char * EspSigKAuthResetContent = R"foo(
 /* ******************************************************************** */
 /* ******************************************************************** */
 /* ******************************************************************** */
-EspSigK::EspSigK(String hostname, String ssid, String ssidPass, WiFiClient * client)
+// the one definition, for the settings the library is compiled with, see EspSigK.h
+template<size_t size, uint32_t id> const int EspSigKConfigMatchesLibrary<size, id>::linked = 1;
+template struct EspSigKConfigMatchesLibrary<sizeof(EspSigKBase), ESPSIGK_CONFIG_ID>;
+
+EspSigKBase::EspSigKBase(const EspSigKBuffers &buffers, String hostname, String ssid, String ssidPass, WiFiClient * client, int configCheck)
+  : httpClient(client)
+  , paths(buffers.paths)
+  , deltaValues(buffers.deltaValues)
+  , deltaPaths(buffers.deltaPaths)
+  , maxDeltaValues(buffers.maxDeltaValues)
+  , maxDeltaPathLength(buffers.maxDeltaPathLength)
+  , frameQueue(buffers.frameQueue)
+#if ESPSIGK_REST_API
+  , lastValues(buffers.lastValues)
+#endif
+#if ESPSIGK_RECORDER
+  , recorder(paths)
+#endif
+  , meta(buffers.meta)
+  , maxMetaPaths(buffers.maxMetaPaths)
+  , stream(*this, frameQueue, stats)
 {
-  myHostname = hostname;
+  (void)configCheck;    // only there to be linked, see EspSigK.h
+
+  myHostname = hostname.substring(0, buffers.maxHostnameLength);
   mySSID = ssid;
   mySSIDPass = ssidPass;
-  wiFiClient = client;
-
-  wsClientConnected = false;
 
   signalKServerHost = "";
   signalKServerPort = 80;
@@ -103,67 +152,56 @@ EspSigK::EspSigK(String hostname, String ssid, String ssidPass, WiFiClient * cli
 
   printDeltaSerial = false;
   printDebugSerial = false;
-  lastPrintDebugSerialHadNewline = true;
 
-  wsClientReconnectInterval = 10000;
-  
-  timerReconnect  = millis();
+  memset(&stats, 0, sizeof(stats));
 
   idxDeltaValues = 0; // init deltas
-  for (uint8_t i = 0; i < MAX_DELTA_VALUES; i++) { 
-    deltaPaths[i] = ""; 
-    deltaValues[i] = "";
-  }
+  metaCount = 0;
+#if ESPSIGK_REST_API
+  memset(lastValues, 0, paths.capacity() * sizeof(cachedValue));
+#endif
+#if ESPSIGK_NETWORK_TASK
+  networkTask = NULL;
+#endif
+#if ESPSIGK_LATENCY
+  latency.reset();
+  stream.setLatency(&latency);
+  deltaCapturedMicros = 0;
+  pingSentMicros = 0;
+  pingOutstanding = false;
+  timerPing = millis();
+  timerLatencyReport = millis();
+#endif
 }
 
-void EspSigK::setServerHost(String newServer) {
+void EspSigKBase::setServerHost(String newServer) {
   signalKServerHost = newServer;
 }
-void EspSigK::setServerPort(uint16_t newPort) {
+void EspSigKBase::setServerPort(uint16_t newPort) {
   signalKServerPort = newPort;
 }
-void EspSigK::setServerToken(String token) {
+void EspSigKBase::setServerToken(String token) {
     signalKServerToken = token;
 }
-void EspSigK::setPrintDeltaSerial(bool v) {
+void EspSigKBase::setPrintDeltaSerial(bool v) {
   printDeltaSerial = v;
 }
-void EspSigK::setPrintDebugSerial(bool v) {
+void EspSigKBase::setPrintDebugSerial(bool v) {
   printDebugSerial = v;
+  espSigKLog.setEnabled(v);
 }
-bool EspSigK::isPrintDebugSerial() {
+bool EspSigKBase::isPrintDebugSerial() {
   return printDebugSerial;
 }
-
-void EspSigK::printDebugSerialMessage(const char* message, bool newline) {
-  if (!printDebugSerial) {
-    return;
-  }
-  
-  if (lastPrintDebugSerialHadNewline) Serial.print(SERIAL_DEBUG_MESSAGE_PREFIX);
-  newline ? Serial.println(message) : Serial.print(message);
-  lastPrintDebugSerialHadNewline = newline;
-}
-void EspSigK::printDebugSerialMessage(String message, bool newline) {
-  if (!printDebugSerial) {
-    return;
-  }
-  
-  if (lastPrintDebugSerialHadNewline) Serial.print(SERIAL_DEBUG_MESSAGE_PREFIX);
-  newline ? Serial.println(message) : Serial.print(message);
-  lastPrintDebugSerialHadNewline = newline;
+void EspSigKBase::setReconnectInterval(uint32_t ms) {
+  stream.setReconnectInterval(ms);
 }
-void EspSigK::printDebugSerialMessage(int message, bool newline) {
-  if (!printDebugSerial) {
-    return;
-  }
-  
-  if (lastPrintDebugSerialHadNewline) Serial.print(SERIAL_DEBUG_MESSAGE_PREFIX);
-  newline ? Serial.println(message) : Serial.print(message);
-  lastPrintDebugSerialHadNewline = newline;
+signalKStats EspSigKBase::getStats() {
+  signalKStats current = stats;
+  current.deltasDropped = frameQueue.getDropped();
+  return current;
 }
 
-
 /* ******************************************************************** */
 /* ******************************************************************** */
 /* ******************************************************************** */
@@ -173,28 +211,27 @@ void EspSigK::printDebugSerialMessage(int message, bool newline) {
 /* ******************************************************************** */
 
 
-void EspSigK::connectWifi() {
-  printDebugSerialMessage(F("Connecting to Wifi.."), false);
+void EspSigKBase::connectWifi() {
+  SIGK_INFO("Connecting to Wifi %s", mySSID.c_str());
   WiFi.begin(mySSID.c_str(), mySSIDPass.c_str());
   while (WiFi.status() != WL_CONNECTED) {
     delay(200);
-    printDebugSerialMessage(F("."), false);
+    espSigKLog.drain();
   }
 
-  printDebugSerialMessage(F("Connected, IP:"), false);
-  printDebugSerialMessage(WiFi.localIP().toString(), true);
+  SIGK_INFO("Connected, IP: %s", WiFi.localIP().toString().c_str());
 }
 
-void EspSigK::setupDiscovery() {
+void EspSigKBase::setupDiscovery() {
   if (!MDNS.begin(myHostname.c_str())) {             // Start the mDNS responder for esp8266.local
-    printDebugSerialMessage(F("Error setting up MDNS responder!"), true);
+    SIGK_ERROR("Error setting up MDNS responder!");
   } else {
     MDNS.addService("http", "tcp", 80);
-    printDebugSerialMessage(F("SIGK: mDNS responder started at "), false);
-    printDebugSerialMessage(myHostname, true);
+    SIGK_INFO("mDNS responder started at %s", myHostname.c_str());
   }
-    
-  printDebugSerialMessage(F("SIGK: Starting SSDP..."), true);
+
+#if ESPSIGK_SSDP
+  SIGK_INFO("Starting SSDP...");
   SSDP.setSchemaURL("description.xml");
   SSDP.setHTTPPort(80);
   SSDP.setName(myHostname);
@@ -207,6 +244,7 @@ void EspSigK::setupDiscovery() {
   SSDP.setManufacturerURL("http://www.signalk.org");
   SSDP.setDeviceType("upnp:rootdevice");
   SSDP.begin();
+#endif
 }
 
 
@@ -217,11 +255,10 @@ void EspSigK::setupDiscovery() {
 /* ******************************************************************** */
 /* ******************************************************************** */
 /* ******************************************************************** */
-void EspSigK::begin() {
-  printDebugSerialMessage(F("SIGK: Starting as host: "), false);
-  printDebugSerialMessage(myHostname, true);
+void EspSigKBase::begin() {
+  SIGK_INFO("Starting as host: %s", myHostname.c_str());
 
-  /* Explicitly set the ESP8266 to be a WiFi-client, otherwise, it by default,
+  /* Explicitly set the ESP to be a WiFi-client, otherwise, it by default,
      would try to act as both a client and an access-point and could cause
      network-issues with your other WiFi-devices on your WiFi-network. */
   WiFi.mode(WIFI_STA);
@@ -229,41 +266,74 @@ void EspSigK::begin() {
 
   setupSignalKServerToken();
 
+#if ESPSIGK_RECORDER
+  recorder.begin(myHostname.c_str());
+#endif
   setupDiscovery();
   setupHTTP();
   setupWebSocket();
+  espSigKLog.drain();
+
+#if ESPSIGK_NETWORK_TASK
+  // from here on the network side runs next to loop() instead of inside handle()
+  xTaskCreatePinnedToCore(networkTaskLoop, "EspSigK", NETWORK_TASK_STACK, this, NETWORK_TASK_PRIORITY, &networkTask, NETWORK_TASK_CORE);
+#endif
 }
 
-void EspSigK::handle() {
+void EspSigKBase::handle() {
   yield(); //let the ESP do whatever it needs to...
 
-  //Timers
-  uint32_t currentMilis = millis();
-  //Overflow handle
-  if (timerReconnect > currentMilis) { timerReconnect = currentMilis; }
-
-  // reconnect timers, make sure wifi connected and websocket connected
-  if ( (timerReconnect + wsClientReconnectInterval) < currentMilis) {
-    if (WiFi.status() != WL_CONNECTED) {
-      connectWifi();
-    }
-    if (!wsClientConnected) {
-      connectWebSocketClient(); 
-    }
-    timerReconnect = currentMilis;
+#if ESPSIGK_NETWORK_TASK
+  if (networkTask == NULL) networkHandle();
+#else
+  networkHandle();
+#endif
+
+#if ESPSIGK_LATENCY && LATENCY_REPORT_INTERVAL > 0
+  // not while the sketch is building a delta of its own
+  if (millis() - timerLatencyReport >= LATENCY_REPORT_INTERVAL && idxDeltaValues == 0) {
+    timerLatencyReport = millis();
+    sendLatencyReport();
+  }
+#endif
+#if ESPSIGK_RECORDER
+  {
+    EspSigKLock lock(stateMutex);
+    recorder.handle();
   }
+#endif
+  //Debug output
+  espSigKLog.drain();
+}
 
+#if ESPSIGK_NETWORK_TASK
+void EspSigKBase::networkTaskLoop(void * sigK) {
+  for (;;) {
+    ((EspSigKBase *)sigK)->networkHandle();
+    // sendDelta() wakes us up early when there is a frame to send
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_TASK_POLL_INTERVAL));
+  }
+}
+#endif
 
+// Connections, HTTP server and websocket. Runs from handle(), or in the network task on ESP32.
+void EspSigKBase::networkHandle() {
   //HTTP
   server.handleClient();
-  //WS
-  if (wsClientConnected && webSocketClient.available()) {
-    webSocketClient.poll();
+  //WS: reconnect timer (and WiFi, see connect()), poll, queued deltas
+  stream.handle();
+  if (stream.isConnected()) {
+    sendMeta();
+  }
+#if ESPSIGK_LATENCY
+  if (stream.isConnected() && millis() - timerPing >= LATENCY_PING_INTERVAL) {
+    sendLatencyPing();
   }
+#endif
 }
 
 // our delay function will let stuff like websocket/http etc run instead of blocking
-void EspSigK::safeDelay(unsigned long ms)
+void EspSigKBase::safeDelay(unsigned long ms)
 {
   uint32_t start = millis();
 
@@ -280,20 +350,39 @@ void EspSigK::safeDelay(unsigned long ms)
 /* ******************************************************************** */
 /* ******************************************************************** */
 /* ******************************************************************** */
-void EspSigK::setupHTTP() {
-  printDebugSerialMessage(F("SIGK: Starting HTTP Server"), true);
-  server.onNotFound(htmlHandleNotFound);
+void EspSigKBase::setupHTTP() {
+  SIGK_INFO("Starting HTTP Server");
+  server.onNotFound([&]() {
+#if ESPSIGK_REST_API
+      if (server.uri().startsWith(API_PATH)) {
+        htmlApi();
+        return;
+      }
+#endif
+      htmlHandleNotFound();
+    });
 
+#if ESPSIGK_SSDP
   server.on("/description.xml", HTTP_GET, [](){ SSDP.schema(server.client()); });
+#endif
   server.on("/signalk", HTTP_GET, htmlSignalKEndpoints);
   server.on("/signalk/", HTTP_GET, htmlSignalKEndpoints);
 
+#if ESPSIGK_DELTA_PAGE
   server.on("/",[]() {
-      server.send ( 200, "text/html", EspSigKIndexContents );
+      server.send_P ( 200, "text/html", EspSigKIndexContents );
     });
   server.on("/index.html",[]() {
-      server.send ( 200, "text/html", EspSigKIndexContents );
+      server.send_P ( 200, "text/html", EspSigKIndexContents );
     });
+#endif
+#if ESPSIGK_RECORDER
+  server.on("/signalk/recorder", HTTP_GET, [&]() { htmlRecorder(); });
+#endif
+  server.on("/signalk/stats", HTTP_GET, [&]() { htmlStats(); });
+#if ESPSIGK_LATENCY
+  server.on("/signalk/latency", HTTP_GET, [&]() { htmlLatency(); });
+#endif
   server.on("/reset_auth",[&]() {
       server.send ( 200, "text/html", EspSigKAuthResetContent );
       signalKServerToken = "";
@@ -304,34 +393,321 @@ void EspSigK::setupHTTP() {
   server.begin();
 }
 
+#if ESPSIGK_RECORDER
+// Without arguments lists the recorded segments, with ?segment=N downloads one
+void EspSigKBase::htmlRecorder() {
+  char name[RECORDER_FILENAME_LENGTH];
+  char entry[64];
+
+  uint32_t firstSegment;
+  uint32_t lastSegment;
+  {
+    EspSigKLock lock(stateMutex);
+    recorder.flush(); // include what is still in RAM
+    firstSegment = recorder.getFirstSegment();
+    lastSegment = recorder.getCurrentSegment();
+  }
+
+  if (!server.hasArg("segment")) {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    server.sendContent("[");
+    bool first = true;
+    for (uint32_t segment = firstSegment; segment <= lastSegment; segment++) {
+      recorder.segmentFileName(segment, name, sizeof(name));
+      File file = LittleFS.open(name, "r");
+      if (!file) continue; // e.g. never written, flash full
+      int len = snprintf(entry, sizeof(entry), "%s{\"segment\":%u,\"size\":%u}",
+                         first ? "" : ",", (unsigned int)segment, (unsigned int)file.size());
+      file.close();
+      server.sendContent(entry, len);
+      first = false;
+    }
+    server.sendContent("]");
+    server.sendContent("");
+    return;
+  }
+
+  uint32_t segment = strtoul(server.arg("segment").c_str(), NULL, 10);
+  recorder.segmentFileName(segment, name, sizeof(name));
+  File file = LittleFS.open(name, "r");
+  if (!file) {
+    htmlHandleNotFound();
+    return;
+  }
+  snprintf(entry, sizeof(entry), "attachment; filename=\"%08u.rec\"", (unsigned int)segment);
+  server.sendHeader("Content-Disposition", entry);
+  server.streamFile(file, "application/octet-stream");
+  file.close();
+}
+#endif
+
+void EspSigKBase::htmlStats() {
+  signalKStats current = getStats();
+  char response[384];
+
+  snprintf(response, sizeof(response),
+           "{\"deltasSent\":%u,\"deltasNotConnected\":%u,\"deltasDropped\":%u,\"deltasOversize\":%u,\"valuesPathRejected\":%u,\"valuesNotCached\":%u,\"bytesSent\":%u,\"sendErrors\":%u,"
+           "\"connects\":%u,\"disconnects\":%u,\"lastReconnectTime\":%u,\"connected\":%s,\"uptime\":%u}",
+           (unsigned int)current.deltasSent, (unsigned int)current.deltasNotConnected, (unsigned int)current.deltasDropped,
+           (unsigned int)current.deltasOversize, (unsigned int)current.valuesPathRejected, (unsigned int)current.valuesNotCached,
+           (unsigned int)current.bytesSent, (unsigned int)current.sendErrors, (unsigned int)current.connects,
+           (unsigned int)current.disconnects, (unsigned int)current.lastReconnectTime,
+           stream.isConnected() ? "true" : "false", (unsigned int)millis());
+  server.send(200, "application/json", response);
+}
+
+#if ESPSIGK_REST_API || ESPSIGK_LATENCY
+// Collects output in a small buffer and sends it as HTTP chunks, so a response can be larger than any buffer
+class EspSigKChunkedResponse
+{
+  public:
+    EspSigKChunkedResponse() : length(0) {
+      server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+      server.send(200, "application/json", "");
+    }
+    void print(const char * text) { write(text, strlen(text)); }
+    // numbers and short fixed text only, output longer than 63 characters is cut off
+    void printf(const char * format, ...) __attribute__((format(printf, 2, 3))) {
+      char text[64];
+      va_list args;
+      va_start(args, format);
+      int len = vsnprintf(text, sizeof(text), format, args);
+      va_end(args);
+      if (len > 0) write(text, min((size_t)len, sizeof(text) - 1));
+    }
+    void write(const char * text, size_t len) {
+      while (len > 0) {
+        size_t n = min(len, sizeof(buffer) - length);
+        memcpy(buffer + length, text, n);
+        length += n;
+        text += n;
+        len -= n;
+        if (length == sizeof(buffer)) flush();
+      }
+    }
+    void end() {
+      flush();
+      server.sendContent("");
+    }
+
+  private:
+    void flush() {
+      if (length > 0) server.sendContent(buffer, length);
+      length = 0;
+    }
+
+    char buffer[HTTP_CHUNK_SIZE];
+    size_t length;
+};
+#endif
+
+#if ESPSIGK_LATENCY
+static void printHistogram(EspSigKChunkedResponse &out, const char * name, EspSigKHistogram &histogram) {
+  out.print("\"");
+  out.print(name);
+  out.printf("\":{\"count\":%u,\"mean\":%u,", (unsigned int)histogram.getCount(), (unsigned int)histogram.getMean());
+  out.printf("\"p50\":%u,\"p90\":%u,", (unsigned int)histogram.getPercentile(50), (unsigned int)histogram.getPercentile(90));
+  out.printf("\"p99\":%u,\"max\":%u,\"buckets\":[", (unsigned int)histogram.getPercentile(99), (unsigned int)histogram.getMax());
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    out.printf(i == 0 ? "%u" : ",%u", (unsigned int)histogram.getBucket(i));
+  }
+  out.print("]}");
+}
+
+// Latency histograms in microseconds, bucket i counts 2^i to 2^(i+1) - 1 us. ?reset clears them.
+void EspSigKBase::htmlLatency() {
+  if (server.hasArg("reset")) {
+    latency.reset();
+  }
+
+  EspSigKChunkedResponse out;
+  out.print("{");
+  printHistogram(out, "captureToSerialize", latency.captureToSerialize);
+  out.print(",");
+  printHistogram(out, "serializeToSend", latency.serializeToSend);
+  out.print(",");
+  printHistogram(out, "captureToSend", latency.captureToSend);
+  out.print(",");
+  printHistogram(out, "roundTrip", latency.roundTrip);
+  out.printf(",\"pingsSent\":%u,\"pingsLost\":%u}", (unsigned int)latency.pingsSent, (unsigned int)latency.pingsLost);
+  out.end();
+}
+#endif
+
+#if ESPSIGK_REST_API
+
+// {"value":..,"$source":"ESP.<hostname>","timestamp":".."}, no timestamp until the clock is set (SNTP)
+static void printCachedValue(EspSigKChunkedResponse &out, const cachedValue &cached, const char * source) {
+  out.print("{\"value\":");
+  switch (cached.value.type) {
+    case DELTA_VALUE_INT:    out.printf("%d", cached.value.i); break;
+    case DELTA_VALUE_DOUBLE: isfinite(cached.value.d) ? out.printf("%.10g", cached.value.d) : out.print("null"); break;
+    case DELTA_VALUE_BOOL:   out.print(cached.value.b ? "true" : "false"); break;
+  }
+  out.print(",\"$source\":\"ESP.");
+  out.print(source);
+  out.print("\"");
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec > 1600000000) {
+    int64_t captured = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000 - (uint32_t)(millis() - cached.capturedMillis);
+    time_t seconds = captured / 1000;
+    struct tm tm;
+    char timestamp[32];
+    gmtime_r(&seconds, &tm);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+    out.printf(",\"timestamp\":\"%s.%03uZ\"", timestamp, (unsigned int)(captured % 1000));
+  }
+  out.print("}");
+}
+
+// Current values under /signalk/v1/api/vessels/self, the whole tree, a subtree or a single value.
+// The model root and /vessels hold the same tree as their only vessel, the node only knows itself.
+void EspSigKBase::htmlApi() {
+  uint8_t handles[PATH_HANDLE_NONE];
+  uint8_t count = 0;
+  const char * treeOpen = "";
+  const char * treeClose = "";
+
+  // "/signalk/v1/api/vessels/self/navigation/speedOverGround" -> "navigation.speedOverGround"
+  String uri = server.uri();
+  if (uri.endsWith("/")) uri.remove(uri.length() - 1);
+  const char * rest = "";
+  if (uri == API_PATH) {
+    treeOpen = "{\"version\":\"" SIGNALK_API_VERSION "\",\"self\":\"vessels.self\",\"vessels\":{\"self\":";
+    treeClose = "}}";
+  } else if (uri == API_PATH "/vessels") {
+    treeOpen = "{\"self\":";
+    treeClose = "}";
+  } else if (uri.startsWith(API_SELF_PATH)) {
+    rest = uri.c_str() + strlen(API_SELF_PATH);
+    if (*rest != '\0' && *rest != '/') {
+      htmlHandleNotFound();
+      return;
+    }
+    if (*rest == '/') rest++;
+  } else {
+    htmlHandleNotFound();
+    return;
+  }
+  String prefixString = rest;
+  prefixString.replace('/', '.');
+  if (prefixString.endsWith(".")) prefixString.remove(prefixString.length() - 1);
+  const char * prefix = prefixString.c_str();
+  size_t prefixLength = prefixString.length();
+
+  // paths in the subtree, sorted so that everything below an object is contiguous.
+  // loop() may add paths and values meanwhile, see EspSigKPathTable
+  {
+    EspSigKLock lock(stateMutex);
+    uint8_t pathCount = paths.count();
+    for (uint8_t h = 0; h < pathCount; h++) {
+      const char * path = paths.get(h);
+      if (!lastValues[h].valid) continue;
+      if (prefixLength > 0 && (strncmp(path, prefix, prefixLength) != 0 || (path[prefixLength] != '\0' && path[prefixLength] != '.'))) continue;
+
+      uint8_t i = count++;
+      while (i > 0 && strcmp(paths.get(handles[i - 1]), path) > 0) {
+        handles[i] = handles[i - 1];
+        i--;
+      }
+      handles[i] = h;
+    }
+  }
+  if (count == 0 && prefixLength > 0) {
+    htmlHandleNotFound();
+    return;
+  }
+
+  EspSigKChunkedResponse out;
+  cachedValue cached;
+
+  if (prefixLength > 0 && paths.get(handles[0])[prefixLength] == '\0') {
+    // a single value
+    {
+      EspSigKLock lock(stateMutex);
+      cached = lastValues[handles[0]];
+    }
+    printCachedValue(out, cached, myHostname.c_str());
+    out.end();
+    return;
+  }
+
+  // Each path is written as nested objects. Compared to the previous path, close the objects
+  // it doesn't share, then open the ones that are new.
+  const char * previous = "";
+  uint8_t previousDepth = 0;
+  out.print(treeOpen);
+  out.print("{");
+  for (uint8_t n = 0; n < count; n++) {
+    const char * path = paths.get(handles[n]) + (prefixLength > 0 ? prefixLength + 1 : 0);
+
+    uint8_t shared = 0;
+    for (size_t i = 0; path[i] != '\0' && path[i] == previous[i]; i++) {
+      if (path[i] == '.') shared++;
+    }
+    for (uint8_t i = shared; i < previousDepth; i++) out.print("}");
+    if (n > 0) out.print(",");
+
+    const char * segment = path;
+    for (uint8_t i = 0; i < shared; i++) segment = strchr(segment, '.') + 1;
+    uint8_t depth = shared;
+    const char * dot;
+    while ((dot = strchr(segment, '.')) != NULL) {
+      out.print("\"");
+      out.write(segment, dot - segment);
+      out.print("\":{");
+      segment = dot + 1;
+      depth++;
+    }
+    out.print("\"");
+    out.write(segment, strlen(segment));
+    out.print("\":");
+
+    {
+      EspSigKLock lock(stateMutex);
+      cached = lastValues[handles[n]];
+    }
+    printCachedValue(out, cached, myHostname.c_str());
+
+    previous = path;
+    previousDepth = depth;
+  }
+  for (uint8_t i = 0; i < previousDepth; i++) out.print("}");
+  out.print("}");
+  out.print(treeClose);
+  out.end();
+}
+#endif
+
 void htmlHandleNotFound(){
   server.send(404, "text/plain", "404: Not found"); // Send HTTP status 404 (Not Found) when there's no handler for the URI in the request
 }
 
 void htmlSignalKEndpoints() {
   IPAddress ip;
-  const int capacity = JSON_OBJECT_SIZE(JSON_DESERIALIZE_DELTA_SIZE);
-  StaticJsonDocument<capacity> jsonBuffer;
-  char response[2048];
-  String wsURL;
+  StaticJsonDocument<JSON_SERIALIZE_ENDPOINTS_SIZE> jsonBuffer;
+  char response[256];
+  char wsURL[32];
+  char httpURL[48];
   ip = WiFi.localIP();
  
-  JsonObject json = jsonBuffer.createNestedObject();
-  String ipString = String(ip[0]);
-  for (uint8_t octet = 1; octet < 4; ++octet) {
-    ipString += '.' + String(ip[octet]);
-  }
-
-
-  wsURL = "ws://" + ipString + ":81/";
+  JsonObject json = jsonBuffer.to<JsonObject>();
+  snprintf(wsURL, sizeof(wsURL), "ws://%u.%u.%u.%u:81/", ip[0], ip[1], ip[2], ip[3]);
+  snprintf(httpURL, sizeof(httpURL), "http://%u.%u.%u.%u/signalk/v1/api/", ip[0], ip[1], ip[2], ip[3]);
 
   JsonObject endpoints = json.createNestedObject("endpoints");
   JsonObject v1 = endpoints.createNestedObject("v1");
-  v1["version"] = "1.alpha1";
-  v1["signalk-ws"] = wsURL;
+  v1["version"] = SIGNALK_API_VERSION;
+  v1["signalk-ws"] = (const char *)wsURL;
+#if ESPSIGK_REST_API
+  v1["signalk-http"] = (const char *)httpURL;
+#endif
   JsonObject serverInfo = json.createNestedObject("server");
   serverInfo["id"] = "ESP-SigKSen";
-  serializeJson(json, response);
+  serializeJson(json, response, sizeof(response));
   server.send ( 200, "application/json", response);
 }
 
@@ -342,16 +718,25 @@ void htmlSignalKEndpoints() {
 /* ******************************************************************** */
 /* ******************************************************************** */
 /* ******************************************************************** */
-void EspSigK::setupWebSocket() {
+void EspSigKBase::setupWebSocket() {
   
   webSocketClient.onMessage(webSocketClientMessage);
+  webSocketClient.onEvent([&](websockets::WebsocketsEvent event, String data) {
+      if (event == websockets::WebsocketsEvent::ConnectionClosed) stream.closed();
+#if ESPSIGK_LATENCY
+      if (event == websockets::WebsocketsEvent::GotPong && pingOutstanding) {
+        latency.roundTrip.add(micros() - pingSentMicros);
+        pingOutstanding = false;
+      }
+#endif
+    });
 
-  connectWebSocketClient();
+  stream.connect();
 }
 
-bool EspSigK::getMDNSService(String &host, uint16_t &port) {
+bool EspSigKBase::getMDNSService(String &host, uint16_t &port) {
   // get IP address using an mDNS query
-  printDebugSerialMessage(F("Searching for server via mDNS"), true);
+  SIGK_INFO("Searching for server via mDNS");
   int n = MDNS.queryService("signalk-ws", "tcp");
   if (n==0) {
     // no service found
@@ -359,10 +744,7 @@ bool EspSigK::getMDNSService(String &host, uint16_t &port) {
   } else {
     host = MDNS.IP(0).toString();
     port = MDNS.port(0);
-    printDebugSerialMessage(F("Found SignalK Server via mDNS at: "), false);
-    printDebugSerialMessage(host, false);
-    printDebugSerialMessage(F(":"), false);
-    printDebugSerialMessage(port, false);
+    SIGK_INFO("Found SignalK Server via mDNS at: %s:%u", host.c_str(), port);
     return true;
   }
 }
@@ -370,11 +752,17 @@ bool EspSigK::getMDNSService(String &host, uint16_t &port) {
 
 
 
-void EspSigK::connectWebSocketClient() {
+// EspSigKTransport, stream.handle() calls these. connect() comes from the reconnect timer,
+// which also brings back WiFi.
+bool EspSigKBase::connect() {
   String host = "";
   uint16_t port = 80;
   String url = "/signalk/v1/stream?subscribe=none";
 
+  if (WiFi.status() != WL_CONNECTED) {
+    connectWifi();
+  }
+
   if (signalKServerHost.length() == 0) {
     getMDNSService(host, port);
   } else {
@@ -384,21 +772,99 @@ void EspSigK::connectWebSocketClient() {
 
   if ( (host.length() > 0) && 
        (port > 0) ) {
-    printDebugSerialMessage(F("Websocket client attempting to connect!"), true);
+    SIGK_INFO("Websocket client attempting to connect!");
   } else {
-    printDebugSerialMessage(F("No server for websocket client"), true);
-    return;
+    SIGK_WARN("No server for websocket client");
+    return false;
   }
   if (signalKServerToken != "") {
     url = url + "&token=" + signalKServerToken;
   }
 
-  wsClientConnected = webSocketClient.connect(host, port, url);
+  if (!webSocketClient.connect(host, port, url)) {
+    SIGK_WARN("Websocket client could not connect to %s:%u", host.c_str(), port);
+    return false;
+  }
+  return true;
+}
+
+void EspSigKBase::connected() {
+  if (stats.disconnects > 0) {
+    SIGK_INFO("Websocket reconnected after %u ms", (unsigned int)stats.lastReconnectTime);
+  }
+
+  // new connection, the server needs all meta again
+  EspSigKLock lock(stateMutex);
+  for (uint8_t i = 0; i < metaCount; i++) {
+    meta[i].sent = false;
+  }
+}
+
+/*
+ * Websocket connection loss, see EspSigKStream. The ConnectionClosed event (close
+ * frame, or the library noticing the socket closed) calls stream.closed() too.
+ */
+bool EspSigKBase::available() {
+  return webSocketClient.available();
 }
 
+void EspSigKBase::poll() {
+  webSocketClient.poll();
+}
+
+bool EspSigKBase::send(const char * frame, size_t length) {
+  return webSocketClient.send(frame, length);
+}
+
+void EspSigKBase::close() {
+  webSocketClient.close(); // release the socket, no-op if the library already closed it
+}
+
+void EspSigKBase::lost() {
+#if ESPSIGK_LATENCY
+  if (pingOutstanding) latency.pingsLost++;
+  pingOutstanding = false;
+#endif
+  SIGK_WARN("Websocket connection lost");
+}
+
+#if ESPSIGK_LATENCY
+// Round trip probe. The pong is only seen when the websocket is polled next, so the
+// measured time includes up to one poll interval (NETWORK_TASK_POLL_INTERVAL or the loop).
+void EspSigKBase::sendLatencyPing() {
+  timerPing = millis();
+  if (pingOutstanding) latency.pingsLost++;
+  pingSentMicros = micros();
+  pingOutstanding = webSocketClient.ping();
+  if (pingOutstanding) latency.pingsSent++;
+}
+
+// sensors.<hostname>.latency.{delta,roundTrip}.{mean,p99,max} in seconds, since boot or the last reset.
+// delta is captureToSend, the time from addDeltaValue() to the socket. Only called with no delta being built.
+void EspSigKBase::sendLatencyReport() {
+  static const char * const names[] = { "mean", "p99", "max" };
+  struct { const char * name; EspSigKHistogram * histogram; } reports[] = {
+    { "delta", &latency.captureToSend },
+    { "roundTrip", &latency.roundTrip },
+  };
+  for (uint8_t r = 0; r < 2; r++) {
+    EspSigKHistogram &histogram = *reports[r].histogram;
+    if (histogram.getCount() == 0) continue;
+    uint32_t values[] = { histogram.getMean(), histogram.getPercentile(99), histogram.getMax() };
+    for (uint8_t i = 0; i < 3; i++) {
+      // 6 values in all, sent in as many deltas as maxDeltaValues needs
+      if (idxDeltaValues >= maxDeltaValues) sendDelta();
+      String path = "sensors." + myHostname + ".latency." + reports[r].name + "." + names[i];
+      addDeltaValue(path, values[i] / 1e6);
+    }
+  }
+  if (idxDeltaValues > 0) sendDelta();
+}
+#endif
+
 void webSocketClientMessage(websockets::WebsocketsMessage message) {
   String payload = message.data();
-  Serial.printf("[WSc] get text: %s\n", payload);
+  SIGK_DEBUG("[WSc] get text: %s", payload.c_str());
   // receiveDelta(payload);
 }
 
@@ -412,257 +878,355 @@ void webSocketClientMessage(websockets::WebsocketsMessage message) {
 /* ******************************************************************** */
 /* ******************************************************************** */
 
-void EspSigK::setupSignalKServerToken() {
+void EspSigKBase::setupSignalKServerToken() {
   if (signalKServerToken == "") {
-    char serverToken[256] = "";
+    char serverToken[SIGNALKAUTH_TOKEN_LENGTH] = "";
     getServerToken(serverToken);
     setServerToken(String(serverToken));
   }
+  // polling is over, don't keep the server connection open
+  httpClient.close();
 }
 
-void EspSigK::getServerToken(char * token) {
-  strcpy(signalKclientId, preferencesGetClientId().c_str());
-  printDebugSerialMessage("Client ID: ", false);
-  printDebugSerialMessage(signalKclientId, true);
+void EspSigKBase::getServerToken(char * token) {
+  strlcpy(signalKclientId, preferencesGetClientId().c_str(), sizeof(signalKclientId));
+  SIGK_DEBUG("Client ID: %s", signalKclientId);
 
   getRequestHref(signalKclientId, signalKrequestHref);
   getRequestToken(signalKrequestHref, token);
 
-  printDebugSerialMessage("getRequestToken return token: ", false);
-  printDebugSerialMessage(token, true);
+  SIGK_DEBUG("getRequestToken return token: %s", token);
 }
 
-void EspSigK::getRequestHref(const char * clientId, char * requestHref) {
-  strcpy(requestHref, preferencesGetRequestHref().c_str());
+void EspSigKBase::getRequestHref(const char * clientId, char * requestHref) {
+  strlcpy(requestHref, preferencesGetRequestHref().c_str(), SIGNALKAUTH_STR_LENGTH);
   if (strcmp(requestHref, "") != 0) {
-    printDebugSerialMessage(F("requestHref was found from settings"), true);
+    SIGK_DEBUG("requestHref was found from settings");
     return;
   }
 
-  String requestJson = "{\"clientId\":\"" + String(clientId) + "\",\"description\":\"" + myHostname + "\"}";
-  String path = String(F("/signalk/v1/access/requests"));
+  char requestJson[HTTP_REQUEST_PAYLOAD_SIZE];
+  snprintf(requestJson, sizeof(requestJson), "{\"clientId\":\"%s\",\"description\":\"%s\"}", clientId, myHostname.c_str());
+  const char * path = "/signalk/v1/access/requests";
 
   signalKAccessResponse accessResponse;
 
-  printDebugSerialMessage(F("Getting access request href..."), false);
-  const char * newRequestHref;
+  SIGK_INFO("Getting access request href...");
   while (strcmp(requestHref, "") == 0) {
     accessResponse = sendAccessRequest(path, true, requestJson);
-    printDebugSerialMessage(accessResponse.href, true);
-    newRequestHref = accessResponse.href.c_str();
-    strcpy(requestHref, newRequestHref);
-    printDebugSerialMessage(".", false);
+    strlcpy(requestHref, accessResponse.href, SIGNALKAUTH_STR_LENGTH);
+    espSigKLog.drain();
     delay(1000);
   }
-  printDebugSerialMessage(requestHref, true);
+  SIGK_INFO("Access request href: %s", requestHref);
 
   preferencesPutRequestHref(requestHref);
 }
 
-void EspSigK::getRequestToken(const char * requestHref, char * token) {
+void EspSigKBase::getRequestToken(const char * requestHref, char * token) {
   String tokenStr = preferencesGetServerToken();
   if (tokenStr != "") {
-    strcpy(token, tokenStr.c_str());
-    printDebugSerialMessage(F("serverToken was found from settings"), true);
+    strlcpy(token, tokenStr.c_str(), SIGNALKAUTH_TOKEN_LENGTH);
+    SIGK_DEBUG("serverToken was found from settings");
     return;
   }
 
   signalKAccessResponse accessResponse;
-  String jsonPayload = String("");
 
-  printDebugSerialMessage(F("Getting request token..."), false);
+  SIGK_INFO("Getting request token...");
 
-  const char * newServerToken;
   while (strcmp(token, "") == 0) {
-    accessResponse = sendAccessRequest(requestHref, false, jsonPayload);
-    printDebugSerialMessage("[" + accessResponse.state + "] ", true);
-    newServerToken = accessResponse.accessRequestToken.c_str();
-    strcpy(token, newServerToken);
+    accessResponse = sendAccessRequest(requestHref, false, "");
+    SIGK_INFO("[%s]", accessResponse.state);
+    strlcpy(token, accessResponse.accessRequestToken, SIGNALKAUTH_TOKEN_LENGTH);
+    espSigKLog.drain();
     delay(1000);
   }
 
-  printDebugSerialMessage(F("Got token: "), false);
-  printDebugSerialMessage(token, true);
+  SIGK_INFO("Got token: %s", token);
 
   preferencesPutServerToken(token);
 }
 
-signalKAccessResponse EspSigK::sendAccessRequest(const String &urlPath, bool isPost, const String &jsonPayload) {
+signalKAccessResponse EspSigKBase::sendAccessRequest(const char * urlPath, bool isPost, const char * jsonPayload) {
   signalKAccessResponse response;
-  response.error = 0;
-
-  printDebugSerialMessage(F("sendAccessRequest called, now connecting to "), false);
-  printDebugSerialMessage(signalKServerHost, false);
-  printDebugSerialMessage(F(":"), false);
-  printDebugSerialMessage(signalKServerPort, false);
-  printDebugSerialMessage(urlPath, true);
-
-  printDebugSerialMessage(F("Wifi status: "), false);
-  printDebugSerialMessage(WiFi.status(), true);
-
-  if (! wiFiClient->connect(signalKServerHost, signalKServerPort)) {
-    printDebugSerialMessage(F("sendAccessRequest could not connect to server"), true);
-    response.error = 1;
-    return response;
+  memset(&response, 0, sizeof(response));
+
+  SIGK_DEBUG("%s %s:%u%s", isPost ? "POST" : "GET", signalKServerHost.c_str(), signalKServerPort, urlPath);
+
+  char body[HTTP_RESPONSE_BODY_SIZE];
+  int32_t bodyLength;
+  int status = httpClient.request(signalKServerHost.c_str(), signalKServerPort, isPost ? "POST" : "GET", urlPath, jsonPayload,
+                                  body, sizeof(body), bodyLength);
+  switch (status) {
+    case HTTP_ERROR_CONNECT:
+      SIGK_ERROR("sendAccessRequest could not connect to server");
+      response.error = 1;
+      return response;
+    case HTTP_ERROR_WRITE:
+      SIGK_ERROR("Could not write to server");
+      response.error = 2;
+      return response;
+    case HTTP_ERROR_REQUEST_TOO_LONG:
+      SIGK_ERROR("HTTP request too long");
+      response.error = 2;
+      return response;
+    case HTTP_ERROR_RESPONSE:
+      SIGK_ERROR("Invalid response");
+      response.error = 3;
+      return response;
+    case HTTP_ERROR_BODY:
+      SIGK_ERROR("Invalid response body");
+      response.error = 3;
+      return response;
+    case HTTP_ERROR_BODY_TOO_LARGE:
+      SIGK_ERROR("Response larger than HTTP_RESPONSE_BODY_SIZE, raise SIGNALKAUTH_TOKEN_LENGTH");
+      response.error = 3;
+      return response;
   }
+  response.httpStatus = status;
 
-  while (!wiFiClient->connected()) {
-    printDebugSerialMessage(F("Waiting while connected to "), false);
-    printDebugSerialMessage(urlPath, true);
-    delay(50);
-  }
- 
-  if (isPost) {
-    printDebugSerialMessage("POST: ", false);
-    wiFiClient->println("POST " + urlPath + " HTTP/1.1");
-    printDebugSerialMessage(urlPath, true);
-  }
-  else {
-    printDebugSerialMessage("GET: ", false);
-    wiFiClient->println("GET " + urlPath + " HTTP/1.1");
-    printDebugSerialMessage(urlPath, true);
-  }
-  wiFiClient->println("Host: " + myHostname);
-  if (jsonPayload != "") {
-    wiFiClient->println(F("Content-type: application/json"));
-    wiFiClient->println("Content-length: " + String(jsonPayload.length()));
-    wiFiClient->println(); // end HTTP header
-    wiFiClient->println(jsonPayload);
-    printDebugSerialMessage(F("Payload: "), false);
-    printDebugSerialMessage(jsonPayload, true);
-  }
-  else {
-    printDebugSerialMessage("No payload", true);
-  }
-
-  if (wiFiClient->println() == 0) {
-    wiFiClient->stop();
-    printDebugSerialMessage(F("Error: Could not write to server"), true);
-    response.error = 2;
-    return response;
-  }
-
-  // Read HTTP status
-  char httpStatus[32] = {0};
-  wiFiClient->readBytesUntil('\r', httpStatus, sizeof(httpStatus));
-
-  // Skip HTTP headers
-  char endOfHeaders[] = "\r\n\r\n";
-  if (!wiFiClient->find(endOfHeaders)) {
-    printDebugSerialMessage(F("Error: Invalid response"), true);
-    wiFiClient->stop();
-    response.error = 3;
+  SIGK_DEBUG("HTTP status: %d", status);
+  if (status >= 400) {
+    response.error = 5;
     return response;
   }
 
-  const int capacity = JSON_OBJECT_SIZE(JSON_DESERIALIZE_HTTP_RESPONSE_SIZE);
-  DynamicJsonDocument payload(capacity);
-  // const int capacityAccessRequest = JSON_OBJECT_SIZE(JSON_DESERIALIZE_HTTP_RESPONSE_SIZE);
-  // StaticJsonDocument<capacityAccessRequest> payloadAccessRequest;
-
-  DeserializationError error = deserializeJson(payload, *wiFiClient);
+  // Only keep the fields we use, everything else in the response is skipped by the parser
+  StaticJsonDocument<JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(2)> filter;
+  filter["state"] = true;
+  filter["href"] = true;
+  JsonObject filterAccessRequest = filter.createNestedObject("accessRequest");
+  filterAccessRequest["permission"] = true;
+  filterAccessRequest["token"] = true;
+
+  // body is a mutable char array so the strings are not copied into the document
+  StaticJsonDocument<JSON_DESERIALIZE_HTTP_RESPONSE_SIZE> payload;
+  DeserializationError error = deserializeJson(payload, body, bodyLength, DeserializationOption::Filter(filter));
   if (error) {
-    printDebugSerialMessage(F("deserializeJson() failed: "), false);
-    printDebugSerialMessage(error.f_str(), true);
-    wiFiClient->stop();
+    SIGK_ERROR("deserializeJson() failed: %s", error.c_str());
     response.error = 4;
     return response;
   }
 
-  response.state = String((const char*)payload["state"]);
-  response.href = String((const char*)payload["href"]);
-  response.accessRequestPermission = String((const char*)payload["accessRequest"]["permission"]);
-  response.accessRequestToken = String((const char*)payload["accessRequest"]["token"]);
+  strlcpy(response.state, payload["state"] | "", sizeof(response.state));
+  strlcpy(response.href, payload["href"] | "", sizeof(response.href));
+  strlcpy(response.accessRequestPermission, payload["accessRequest"]["permission"] | "", sizeof(response.accessRequestPermission));
+  strlcpy(response.accessRequestToken, payload["accessRequest"]["token"] | "", sizeof(response.accessRequestToken));
 
-  printDebugSerialMessage("state: ", false);
-  printDebugSerialMessage(response.state, true);
-  printDebugSerialMessage("href: ", false);
-  printDebugSerialMessage(response.href, true);
-  printDebugSerialMessage("accessRequstPermission: ", false);
-  printDebugSerialMessage(response.accessRequestPermission, true);
-  printDebugSerialMessage("accessRequestToken: ", false);
-  printDebugSerialMessage(response.accessRequestToken, true);
+  SIGK_DEBUG("state: %s href: %s permission: %s token: %s",
+             response.state, response.href, response.accessRequestPermission, response.accessRequestToken);
 
   return response;
 }
 
-void EspSigK::addDeltaValue(String path, int value) {
-  String v = String(value);
-  deltaPaths[idxDeltaValues] = path;
-  deltaValues[idxDeltaValues] = v;
+
+// Returns the slot for the next value, or NULL (value dropped) if the delta is full or the path too long
+deltaValue * EspSigKBase::nextDeltaValue(const char * path) {
+  if (idxDeltaValues >= maxDeltaValues) {
+    SIGK_WARN("Delta full, dropping %s", path);
+    return NULL;
+  }
+  size_t pathLength = strlen(path);
+  if (pathLength >= maxDeltaPathLength) {
+    stats.valuesPathRejected++;
+    SIGK_WARN("Path longer than maxDeltaPathLength, dropping %s", path);
+    return NULL;
+  }
+  memcpy(deltaPaths + idxDeltaValues * maxDeltaPathLength, path, pathLength + 1);
+
+  deltaValue * v = &deltaValues[idxDeltaValues];
+#if ESPSIGK_REST_API || ESPSIGK_RECORDER
+  // the handle is only for the REST API and the recorder, without one the value is still sent
+  v->pathHandle = paths.intern(path);
+  if (v->pathHandle == PATH_HANDLE_NONE && stats.valuesNotCached++ == 0) {
+    SIGK_WARN("Path table full, %s and further new paths are sent but not cached", path);
+  }
+#else
+  v->pathHandle = PATH_HANDLE_NONE;
+#endif
+#if ESPSIGK_LATENCY
+  // | 1 so a capture at micros() == 0 isn't taken for "no capture time"
+  if (idxDeltaValues == 0) deltaCapturedMicros = micros() | 1;
+#endif
   idxDeltaValues++;
+  return v;
 }
-void EspSigK::addDeltaValue(String path, double value) {
-  String v = String(value);
-  deltaPaths[idxDeltaValues] = path;
-  deltaValues[idxDeltaValues] = v;
-  idxDeltaValues++;
+
+void EspSigKBase::addDeltaValue(const char * path, int value) {
+  deltaValue * v = nextDeltaValue(path);
+  if (v == NULL) return;
+  v->type = DELTA_VALUE_INT;
+  v->i = value;
+  cacheDeltaValue(v);
 }
-void EspSigK::addDeltaValue(String path, bool value) {
-  String v;
-  if (value) { v = "true"; } else { v = "false"; }
-  deltaPaths[idxDeltaValues] = path;
-  deltaValues[idxDeltaValues] = v;
-  idxDeltaValues++;
+void EspSigKBase::addDeltaValue(const char * path, double value) {
+  deltaValue * v = nextDeltaValue(path);
+  if (v == NULL) return;
+  v->type = DELTA_VALUE_DOUBLE;
+  v->d = value;
+  cacheDeltaValue(v);
+}
+void EspSigKBase::addDeltaValue(const char * path, bool value) {
+  deltaValue * v = nextDeltaValue(path);
+  if (v == NULL) return;
+  v->type = DELTA_VALUE_BOOL;
+  v->b = value;
+  cacheDeltaValue(v);
 }
 
-void EspSigK::sendDelta(String path, int value) {
+void EspSigKBase::cacheDeltaValue(const deltaValue * v) {
+#if ESPSIGK_REST_API
+  if (v->pathHandle == PATH_HANDLE_NONE) return;
+  EspSigKLock lock(stateMutex);
+  cachedValue &cached = lastValues[v->pathHandle];
+  cached.value = *v;
+  cached.capturedMillis = millis();
+  cached.valid = true;
+#endif
+}
+
+void EspSigKBase::sendDelta(const char * path, int value) {
   addDeltaValue(path, value);
   sendDelta();
 }
-void EspSigK::sendDelta(String path, double value) {
+void EspSigKBase::sendDelta(const char * path, double value) {
   addDeltaValue(path, value);
   sendDelta();
 }
-void EspSigK::sendDelta(String path, bool value) {
+void EspSigKBase::sendDelta(const char * path, bool value) {
   addDeltaValue(path, value);
   sendDelta();
 }
 
-void EspSigK::sendDelta() {
-  const int capacity = JSON_OBJECT_SIZE(JSON_DESERIALIZE_DELTA_SIZE);
-  StaticJsonDocument<capacity> jsonBuffer;
-  String deltaText;
+void EspSigKBase::sendDelta() {
+  // nothing added, or every value was dropped: no empty delta on the wire or in the recorder
+  if (idxDeltaValues == 0) return;
+
+  // serialized straight into the frame queue, the network side sends it
+  uint32_t capturedMicros = 0;
+#if ESPSIGK_LATENCY
+  capturedMicros = deltaCapturedMicros;
+#endif
+  size_t deltaLength = stream.queueDelta(myHostname.c_str(), deltaValues, deltaPaths, maxDeltaPathLength,
+                                         idxDeltaValues, capturedMicros);
+  if (deltaLength == 0) {
+    SIGK_WARN("Frame queue full or delta larger than deltaFrameSize, dropped");
+  } else if (printDeltaSerial) {
+    espSigKLog.writeLine(stream.lastFrame(), deltaLength);
+  }
+#if ESPSIGK_NETWORK_TASK
+  if (networkTask != NULL) {
+    xTaskNotifyGive(networkTask);
+  } else {
+    stream.sendQueuedFrames();
+  }
+#else
+  stream.sendQueuedFrames();
+#endif
+
+#if ESPSIGK_RECORDER
+  {
+    EspSigKLock lock(stateMutex);
+    recorder.record(deltaValues, deltaPaths, maxDeltaPathLength, idxDeltaValues);
+  }
+#endif
+ 
+  //reset delta info
+  idxDeltaValues = 0;
+#if ESPSIGK_LATENCY
+  deltaCapturedMicros = 0;
+#endif
+}
+
+void EspSigKBase::setMeta(const char * path, const __FlashStringHelper * units, const __FlashStringHelper * displayName,
+                      const signalKMetaZone * zones, uint8_t zoneCount) {
+  uint8_t pathHandle = strlen(path) < maxDeltaPathLength ? paths.intern(path) : PATH_HANDLE_NONE;
+  if (pathHandle == PATH_HANDLE_NONE) {
+    SIGK_WARN("Path longer than maxDeltaPathLength or path table full, no meta for %s", path);
+    return;
+  }
+  if (zoneCount > MAX_META_ZONES) {
+    SIGK_WARN("More than MAX_META_ZONES zones for %s, ignoring the rest", path);
+    zoneCount = MAX_META_ZONES;
+  }
 
-  //  build delta message
-  JsonObject delta = jsonBuffer.createNestedObject();
+  EspSigKLock lock(stateMutex);
+  uint8_t i = 0;
+  while (i < metaCount && meta[i].pathHandle != pathHandle) i++;
+  if (i == metaCount) {
+    if (metaCount >= maxMetaPaths) {
+      SIGK_WARN("More than maxMetaPaths paths with meta, no meta for %s", path);
+      return;
+    }
+    metaCount++;
+  } else if (meta[i].units == units && meta[i].displayName == displayName &&
+             meta[i].zones == zones && meta[i].zoneCount == zoneCount) {
+    return; // unchanged, e.g. set from loop(), the server already has it
+  }
 
-  //updated array
-  JsonArray updatesArr = delta.createNestedArray("updates");
-  
-  JsonObject thisUpdate = updatesArr.createNestedObject();
+  meta[i].pathHandle = pathHandle;
+  meta[i].units = units;
+  meta[i].displayName = displayName;
+  meta[i].zones = zones;
+  meta[i].zoneCount = zoneCount;
+  meta[i].sent = false;
+}
 
-  JsonObject source = thisUpdate.createNestedObject("source");
-  source["label"] = "ESP";
-  source["src"] = myHostname;
-     
-  JsonArray values = thisUpdate.createNestedArray("values");
-  for (uint8_t i = 0; i < idxDeltaValues; i++) {
-    JsonObject thisValue = values.createNestedObject();
-    thisValue["path"] = deltaPaths[i].c_str();
-    thisValue["value"] = serialized(deltaValues[i].c_str());
+// Sends the meta of one path that the server doesn't have yet, called from handle()
+void EspSigKBase::sendMeta() {
+  static const char * const zoneStates[] = { "nominal", "normal", "alert", "warn", "alarm", "emergency" };
+
+  // copy the entry so setMeta() isn't blocked while we send. If it changes
+  // the entry meanwhile it clears sent again and the new meta goes out next.
+  signalKMeta pending;
+  uint8_t m = 0;
+  {
+    EspSigKLock lock(stateMutex);
+    while (m < metaCount && meta[m].sent) m++;
+    if (m == metaCount) return;
+    pending = meta[m];
+    meta[m].sent = true;
   }
 
-        
-  
-  serializeJson(delta, deltaText);
-  if (printDeltaSerial) Serial.println(deltaText);
-  if (wsClientConnected) { // client
-    webSocketClient.send(deltaText);
+  StaticJsonDocument<JSON_SERIALIZE_META_SIZE> jsonBuffer;
+  char metaFrame[META_FRAME_SIZE];
+
+  JsonObject delta = jsonBuffer.to<JsonObject>();
+  JsonObject thisUpdate = delta.createNestedArray("updates").createNestedObject();
+  JsonObject thisMeta = thisUpdate.createNestedArray("meta").createNestedObject();
+  // setMeta() interned the path before storing the handle under the lock taken above
+  thisMeta["path"] = paths.get(pending.pathHandle);
+
+  JsonObject value = thisMeta.createNestedObject("value");
+  if (pending.units) value["units"] = pending.units;
+  if (pending.displayName) value["displayName"] = pending.displayName;
+  if (pending.zoneCount > 0) {
+    JsonArray zones = value.createNestedArray("zones");
+    for (uint8_t i = 0; i < pending.zoneCount; i++) {
+      signalKMetaZone zone;
+      memcpy_P(&zone, &pending.zones[i], sizeof(zone));
+      JsonObject thisZone = zones.createNestedObject();
+      if (!isnan(zone.lower)) thisZone["lower"] = zone.lower;
+      if (!isnan(zone.upper)) thisZone["upper"] = zone.upper;
+      thisZone["state"] = zoneStates[zone.state <= ZONE_EMERGENCY ? zone.state : ZONE_ALARM];
+      if (zone.message) thisZone["message"] = (const __FlashStringHelper *)zone.message;
+    }
   }
- 
-  //reset delta info
-  idxDeltaValues = 0; // init deltas
-  for (uint8_t i = 0; i < MAX_DELTA_VALUES; i++) { 
-    deltaPaths[i] = ""; 
-    deltaValues[i] = "";
+
+  size_t metaLength = serializeJson(delta, metaFrame, sizeof(metaFrame));
+  if (jsonBuffer.overflowed() || metaLength >= sizeof(metaFrame) - 1) {
+    SIGK_WARN("Meta for %s larger than META_FRAME_SIZE, not sent", paths.get(pending.pathHandle));
+  } else if (!webSocketClient.send(metaFrame, metaLength)) {
+    EspSigKLock lock(stateMutex);
+    meta[m].sent = false; // try again on the next handle()
   }
 }
 
-void EspSigK::preferencesClear() {
+void EspSigKBase::preferencesClear() {
   Preferences preferences;
 
-  printDebugSerialMessage(F("preferencesClear"), true);
+  SIGK_DEBUG("preferencesClear");
 
   preferences.begin(PREFERENCES_NAMESPACE, false);
   // ESP8266 failed to delete preferences using preferences.clear() so deleting preferences one by one
@@ -672,37 +1236,30 @@ void EspSigK::preferencesClear() {
   preferences.end();
 }
 
-String EspSigK::preferencesGet(const String &property) {
+String EspSigKBase::preferencesGet(const String &property) {
   Preferences preferences;
 
   preferences.begin(PREFERENCES_NAMESPACE, false);
 
-  printDebugSerialMessage(F("preferencesGet, property: "), false);
-  printDebugSerialMessage(property, false);
-
   String value = preferences.getString(property.c_str(), "");
   preferences.end();
 
-  printDebugSerialMessage(F(", "), false);
-  printDebugSerialMessage(value, true);
+  SIGK_DEBUG("preferencesGet, property: %s, %s", property.c_str(), value.c_str());
 
   return value;
 }
 
-void EspSigK::preferencesPut(const String &property, const String &value) {
+void EspSigKBase::preferencesPut(const String &property, const String &value) {
   Preferences preferences;
 
   preferences.begin(PREFERENCES_NAMESPACE, false);
   preferences.putString(property.c_str(), value);
   preferences.end();
 
-  printDebugSerialMessage(F("preferencesPut, property: "), false);
-  printDebugSerialMessage(property, false);
-  printDebugSerialMessage(F(", value: "), false);
-  printDebugSerialMessage(value, true);
+  SIGK_DEBUG("preferencesPut, property: %s, value: %s", property.c_str(), value.c_str());
 }
 
-String EspSigK::preferencesGetClientId() {
+String EspSigKBase::preferencesGetClientId() {
   UUID uuid;
 
   String clientIdPreferences = preferencesGet(F("clientId"));
@@ -711,8 +1268,7 @@ String EspSigK::preferencesGetClientId() {
     uuid.setRandomMode();
     uuid.generate();
     String newClientId = String(uuid.toCharArray());
-    printDebugSerialMessage("New clientId: ", false);
-    printDebugSerialMessage(newClientId, true);
+    SIGK_DEBUG("New clientId: %s", newClientId.c_str());
     preferencesPut(F("clientId"), newClientId);
     return newClientId;
   }
@@ -720,18 +1276,18 @@ String EspSigK::preferencesGetClientId() {
   return clientIdPreferences;
 }
 
-String EspSigK::preferencesGetRequestHref() {
+String EspSigKBase::preferencesGetRequestHref() {
   return preferencesGet(F("requestHref"));
 }
 
-void EspSigK::preferencesPutRequestHref(const String &value) {
+void EspSigKBase::preferencesPutRequestHref(const String &value) {
   preferencesPut(F("requestHref"), value);
 }
 
-String EspSigK::preferencesGetServerToken() {
+String EspSigKBase::preferencesGetServerToken() {
   return preferencesGet(F("serverToken"));
 }
 
-void EspSigK::preferencesPutServerToken(const String &value) {
+void EspSigKBase::preferencesPutServerToken(const String &value) {
   preferencesPut(F("serverToken"), value);
 }
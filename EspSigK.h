@@ -1,33 +1,110 @@
 #ifndef EspSigK_H
 #define EspSigK_H
 
-extern "C" {
-  #include "user_interface.h"
-}
-
-#include <ESP8266WiFi.h>        // ESP8266 Core WiFi Library (you most likely already have this in your sketch)
-#include <ESP8266mDNS.h>        // Include the mDNS library
-#include <ESP8266SSDP.h>
-#include <ESP8266WebServer.h>   // Local WebServer used to serve the configuration portal
-
+#include "EspSigKConfig.h"
+#include "EspSigKPlatform.h"
 
 #include <ArduinoJson.h>        // https://github.com/bblanchon/ArduinoJson
 #include <ArduinoWebsockets.h>  // https://github.com/gilmaimon/ArduinoWebsockets
 #include <UUID.h>               // https://github.com/RobTillaart/UUID
 #include <Preferences.h>
 
-#define MAX_DELTA_VALUES 10
+#include "EspSigKFrameQueue.h"
+#include "EspSigKHttpClient.h"
+#include "EspSigKLatency.h"
+#include "EspSigKLog.h"
+#include "EspSigKPaths.h"
+#include "EspSigKRecorder.h"
+#include "EspSigKStream.h"
+
+#ifndef SIGNALKAUTH_STR_LENGTH
 #define SIGNALKAUTH_STR_LENGTH 64
+#endif
+#ifndef SIGNALKAUTH_TOKEN_LENGTH
+#define SIGNALKAUTH_TOKEN_LENGTH 256
+#endif
+#define SIGNALKAUTH_STATE_LENGTH 16
 
 struct signalKAccessResponse {
-  String state;
-  String href;
-  String accessRequestPermission;
-  String accessRequestToken;
+  int httpStatus;
+  char state[SIGNALKAUTH_STATE_LENGTH];
+  char href[SIGNALKAUTH_STR_LENGTH];
+  char accessRequestPermission[SIGNALKAUTH_STATE_LENGTH];
+  char accessRequestToken[SIGNALKAUTH_TOKEN_LENGTH];
   int error;
 };
 
-class EspSigK
+enum signalKZoneState : uint8_t {
+  ZONE_NOMINAL,
+  ZONE_NORMAL,
+  ZONE_ALERT,
+  ZONE_WARN,
+  ZONE_ALARM,
+  ZONE_EMERGENCY
+};
+
+// Alarm zone of a path. lower/upper may be NAN for an open end.
+// An array of zones can live in PROGMEM, message may be a PROGMEM string.
+struct signalKMetaZone {
+  double lower;
+  double upper;
+  signalKZoneState state;
+  const char * message;
+};
+
+struct signalKMeta {
+  uint8_t pathHandle;
+  bool sent;                // sent on the current websocket connection
+  const __FlashStringHelper * units;
+  const __FlashStringHelper * displayName;
+  const signalKMetaZone * zones;
+  uint8_t zoneCount;
+};
+
+/*
+ * The feature settings in EspSigKConfig.h (and SIGNALKAUTH_STR_LENGTH) change the
+ * layout of EspSigKBase, so the sketch and the library have to be compiled with the
+ * same values. A #define in the sketch only reaches the sketch (the library .cpp files
+ * are compiled on their own), and the two would silently disagree about the object.
+ * The capacities don't take part, they come from BasicEspSigK's Config.
+ *
+ * The constructor's last argument refers to EspSigKConfigMatchesLibrary<size, id>::linked
+ * for the sketch's settings, and only EspSigK.cpp defines it, for the library's. When they
+ * differ the link fails with "undefined reference to EspSigKConfigMatchesLibrary<...>::linked":
+ * set the values from the build flags (-D...) instead, so both see them.
+ */
+constexpr uint32_t espSigKConfigHash(uint32_t hash, uint32_t value) { return (hash ^ value) * 16777619u; }
+
+#define ESPSIGK_CONFIG_ID \
+  espSigKConfigHash(espSigKConfigHash(espSigKConfigHash(espSigKConfigHash(espSigKConfigHash(espSigKConfigHash( \
+  espSigKConfigHash(2166136261u, \
+  ESPSIGK_REST_API), ESPSIGK_RECORDER), RECORDER_BUFFER_SIZE), ESPSIGK_NETWORK_TASK), ESPSIGK_LATENCY), \
+  LATENCY_BUCKETS), SIGNALKAUTH_STR_LENGTH)
+
+template<size_t size, uint32_t id> struct EspSigKConfigMatchesLibrary {
+  static const int linked;
+};
+
+// What the Config sizes, kept by BasicEspSigK and used through EspSigKBase
+struct EspSigKBuffers {
+  EspSigKPathTable &paths;
+  EspSigKFrameQueue &frameQueue;
+  deltaValue * deltaValues;
+  char * deltaPaths;            // maxDeltaValues paths of maxDeltaPathLength bytes
+  uint8_t maxDeltaValues;
+  size_t maxDeltaPathLength;
+  size_t maxHostnameLength;
+  cachedValue * lastValues;     // one per path handle, NULL without the REST API
+  signalKMeta * meta;
+  uint8_t maxMetaPaths;
+};
+
+/*
+ * Everything but the storage, compiled once in EspSigK.cpp for every Config.
+ * Streams over the ArduinoWebsockets client, as EspSigKStream's transport.
+ * Sketches use EspSigK or BasicEspSigK<Config> (below).
+ */
+class EspSigKBase : protected EspSigKTransport
 {
   protected:
     String myHostname;
@@ -40,60 +117,126 @@ class EspSigK
 
     char signalKclientId[SIGNALKAUTH_STR_LENGTH];
     char signalKrequestHref[SIGNALKAUTH_STR_LENGTH];
+    EspSigKHttpClient httpClient;     // access requests, on the sketch's WiFiClient
 
-    String deltaPaths[MAX_DELTA_VALUES];
-    String deltaValues[MAX_DELTA_VALUES];
+    EspSigKPathTable &paths;
+    deltaValue * const deltaValues;
+    char * const deltaPaths;          // path of each value, maxDeltaPathLength apart, sendDelta() sends these
+    const uint8_t maxDeltaValues;
+    const size_t maxDeltaPathLength;
     uint8_t idxDeltaValues;
+    EspSigKFrameQueue &frameQueue;
+#if ESPSIGK_REST_API
+    cachedValue * const lastValues;   // indexed by path handle
+#endif
+#if ESPSIGK_RECORDER
+    EspSigKRecorder recorder;
+#endif
+    signalKMeta * const meta;
+    const uint8_t maxMetaPaths;
+    uint8_t metaCount;
+    EspSigKMutex stateMutex;    // meta and recorder, shared with the network task
+#if ESPSIGK_NETWORK_TASK
+    TaskHandle_t networkTask;
+#endif
+#if ESPSIGK_LATENCY
+    EspSigKLatency latency;
+    uint32_t deltaCapturedMicros;   // first addDeltaValue() of the delta being built, 0 when none
+    uint32_t pingSentMicros;
+    bool pingOutstanding;
+    uint32_t timerPing;
+    uint32_t timerLatencyReport;
+#endif
 
-    uint32_t wsClientReconnectInterval;
+    signalKStats stats;
+    EspSigKStream stream;     // reconnects, polls the websocket and sends the frame queue
 
-    uint32_t timerReconnect;
     bool printDebugSerial;
-    bool lastPrintDebugSerialHadNewline;
 
-    WiFiClient * wiFiClient;
-    
-    
+    // EspSigKTransport
+    bool connect() override;
+    bool available() override;
+    void poll() override;
+    bool send(const char * frame, size_t length) override;
+    void close() override;
+    void connected() override;
+    void lost() override;
+
+
+
+    // hostname is cut to maxHostnameLength characters, it's the source of every delta and the frame only has room for that many
+    EspSigKBase(const EspSigKBuffers &buffers, String hostname, String ssid, String ssidPass, WiFiClient * client, int configCheck);
 
   public:
-    EspSigK(String hostname, String ssid, String ssidPass, WiFiClient * client);
     void setServerHost(String newServer);
     void setServerPort(uint16_t newPort);
     void setServerToken(String token);
     void setPrintDeltaSerial(bool v);
     void setPrintDebugSerial(bool v);
     bool isPrintDebugSerial();
+    void setReconnectInterval(uint32_t ms);
+    signalKStats getStats();
+#if ESPSIGK_LATENCY
+    EspSigKLatency &getLatency() { return latency; }
+#endif
 
 
     void begin(void);
     void handle(void);
     void safeDelay(unsigned long ms);
 
-    void addDeltaValue(String path, int value);
-    void addDeltaValue(String path, double value);
-    void addDeltaValue(String path, bool value);
+    void addDeltaValue(const char * path, int value);
+    void addDeltaValue(const char * path, double value);
+    void addDeltaValue(const char * path, bool value);
+    void addDeltaValue(const String &path, int value) { addDeltaValue(path.c_str(), value); }
+    void addDeltaValue(const String &path, double value) { addDeltaValue(path.c_str(), value); }
+    void addDeltaValue(const String &path, bool value) { addDeltaValue(path.c_str(), value); }
     void sendDelta();
-    void sendDelta(String path, int value);
-    void sendDelta(String path, double value);
-    void sendDelta(String path, bool value);
+    void sendDelta(const char * path, int value);
+    void sendDelta(const char * path, double value);
+    void sendDelta(const char * path, bool value);
+    void sendDelta(const String &path, int value) { sendDelta(path.c_str(), value); }
+    void sendDelta(const String &path, double value) { sendDelta(path.c_str(), value); }
+    void sendDelta(const String &path, bool value) { sendDelta(path.c_str(), value); }
+
+    // Meta is sent once per websocket connection and again when changed, not with every delta.
+    // The strings and zones are not copied and must stay valid, e.g. F("m/s") or PROGMEM arrays.
+    // Changes are detected by pointer, setting the same strings and zone array again sends nothing.
+    void setMeta(const char * path, const __FlashStringHelper * units, const __FlashStringHelper * displayName,
+                 const signalKMetaZone * zones = NULL, uint8_t zoneCount = 0);
 
   private:
+    void networkHandle();
+#if ESPSIGK_NETWORK_TASK
+    static void networkTaskLoop(void * sigK);
+#endif
     void connectWifi();
     void setupDiscovery();
     void setupHTTP();
 
     void setupWebSocket();
+    void htmlStats();
+#if ESPSIGK_LATENCY
+    void htmlLatency();
+    void sendLatencyPing();
+    void sendLatencyReport();
+#endif
+#if ESPSIGK_REST_API
+    void htmlApi();
+#endif
+#if ESPSIGK_RECORDER
+    void htmlRecorder();
+#endif
     bool getMDNSService(String &host, uint16_t &port);
-    void connectWebSocketClient();
 
-    void printDebugSerialMessage(const char * message, bool newline);
-    void printDebugSerialMessage(String message, bool newline);
-    void printDebugSerialMessage(int message, bool newline);
+    deltaValue * nextDeltaValue(const char * path);
+    void cacheDeltaValue(const deltaValue * v);
+    void sendMeta();
     void setupSignalKServerToken();
     void getServerToken(char * token);
     void getRequestHref(const char * clientId, char * requestHref);
     void getRequestToken(const char * requestHref, char * token);
-    signalKAccessResponse sendAccessRequest(const String &urlPath, bool isPost, const String &jsonPayload);
+    signalKAccessResponse sendAccessRequest(const char * urlPath, bool isPost, const char * jsonPayload);
     void preferencesClear();
     String preferencesGet(const String &property);
     void preferencesPut(const String &property, const String &value);
@@ -105,6 +248,61 @@ class EspSigK
 
 };
 
+// The arrays Config sizes and the checks that they fit, see BasicEspSigK
+template<class Config>
+struct EspSigKStorage
+{
+  static_assert(Config::maxDeltaValues > 0, "maxDeltaValues must be 1 to 255");
+  static_assert(Config::maxDeltaPathLength > 1, "maxDeltaPathLength must hold a path and its terminator");
+  static_assert(Config::maxMetaPaths > 0, "maxMetaPaths must be at least 1");
+  static_assert(Config::deltaFrameSize >= espSigKDeltaFrameWorstCase(Config::maxHostnameLength, Config::maxDeltaValues, Config::maxDeltaPathLength),
+                "deltaFrameSize can't hold maxDeltaValues paths of maxDeltaPathLength, "
+                "set it to espSigKDeltaFrameWorstCase(maxHostnameLength, maxDeltaValues, maxDeltaPathLength)");
+#if ESPSIGK_RECORDER
+  static_assert(RECORDER_SEGMENT_SIZE >= 2 * recordDeltaWithPathsMaxSize(Config::maxDeltaValues, Config::maxDeltaPathLength),
+                "RECORDER_SEGMENT_SIZE can't hold two deltas of maxDeltaValues paths of maxDeltaPathLength");
+#endif
+
+  EspSigKBuffers buffers() {
+    EspSigKBuffers b = {
+      storedPaths, storedFrames, storedValues, storedValuePaths[0],
+      Config::maxDeltaValues, Config::maxDeltaPathLength, Config::maxHostnameLength,
+#if ESPSIGK_REST_API
+      storedLastValues,
+#else
+      NULL,
+#endif
+      storedMeta, Config::maxMetaPaths
+    };
+    return b;
+  }
+
+  EspSigKStaticPathTable<Config::maxPaths, Config::pathTableSize> storedPaths;
+  EspSigKStaticFrameQueue<Config::frameQueueDepth, Config::deltaFrameSize> storedFrames;
+  deltaValue storedValues[Config::maxDeltaValues];
+  char storedValuePaths[Config::maxDeltaValues][Config::maxDeltaPathLength];
+#if ESPSIGK_REST_API
+  cachedValue storedLastValues[Config::maxPaths];
+#endif
+  signalKMeta storedMeta[Config::maxMetaPaths];
+};
+
+/*
+ * An EspSigK node with the capacities of Config (see EspSigKDefaultConfig), checked
+ * at compile time. The storage is a base constructed before EspSigKBase, which only
+ * keeps pointers into it.
+ */
+template<class Config>
+class BasicEspSigK : private EspSigKStorage<Config>, public EspSigKBase
+{
+  public:
+    BasicEspSigK(String hostname, String ssid, String ssidPass, WiFiClient * client,
+                 int configCheck = EspSigKConfigMatchesLibrary<sizeof(EspSigKBase), ESPSIGK_CONFIG_ID>::linked)
+      : EspSigKBase(EspSigKStorage<Config>::buffers(), hostname, ssid, ssidPass, client, configCheck) {}
+};
+
+typedef BasicEspSigK<EspSigKDefaultConfig> EspSigK;
+
 //html stuff
 void htmlSignalKEndpoints();
 void htmlHandleNotFound();
@@ -0,0 +1,150 @@
+#ifndef EspSigKConfig_H
+#define EspSigKConfig_H
+
+#include <Arduino.h>
+
+/*
+ * Sizing and features. All of these can be overridden from the build flags
+ * (e.g. -DMAX_DELTA_VALUES=2 -DESPSIGK_SSDP=0) to fit the node, the checks
+ * below fail the build if the combination doesn't fit.
+ *
+ * The sizes are only the defaults of EspSigKDefaultConfig (below), a sketch can
+ * size its node with its own config instead, see BasicEspSigK in EspSigK.h.
+ */
+#ifndef MAX_DELTA_VALUES
+#define MAX_DELTA_VALUES 10             // values in one delta (addDeltaValue() calls before sendDelta())
+#endif
+#ifndef MAX_DELTA_PATH_LENGTH
+#define MAX_DELTA_PATH_LENGTH 96        // bytes per path, including terminator. The oneWire example needs 68
+#endif
+#ifndef MAX_PATHS
+#define MAX_PATHS 32                    // paths kept for the REST API, the meta and the recorder
+#endif
+#ifndef PATH_TABLE_SIZE
+#define PATH_TABLE_SIZE (MAX_PATHS * 40) // bytes of path text in that table, terminators included
+#endif
+#ifndef MAX_HOSTNAME_LENGTH
+#define MAX_HOSTNAME_LENGTH 32
+#endif
+// worst case serialized delta: envelope + source, then per value {"path":"...","value":<number>},
+constexpr size_t espSigKDeltaFrameWorstCase(size_t hostnameLength, size_t values, size_t pathLength) {
+  return 64 + hostnameLength + values * (pathLength + 48);
+}
+#define DELTA_FRAME_WORST_CASE espSigKDeltaFrameWorstCase(MAX_HOSTNAME_LENGTH, MAX_DELTA_VALUES, MAX_DELTA_PATH_LENGTH)
+#ifndef DELTA_FRAME_SIZE
+#define DELTA_FRAME_SIZE DELTA_FRAME_WORST_CASE
+#endif
+#ifndef MAX_META_PATHS
+#define MAX_META_PATHS 8                // paths with units/displayName/zones set by setMeta()
+#endif
+#ifndef MAX_META_ZONES
+#define MAX_META_ZONES 4                // zones per path
+#endif
+#ifndef META_FRAME_SIZE
+#define META_FRAME_SIZE 512             // serialized meta delta for one path
+#endif
+#ifndef ESPSIGK_STACK_BUDGET
+#define ESPSIGK_STACK_BUDGET 2048       // bytes a single library call may put on the loop() stack
+#endif
+#ifndef ESPSIGK_SSDP
+#if defined(ESP32)
+#define ESPSIGK_SSDP 0                  // needs the ESP32SSDP library on ESP32
+#else
+#define ESPSIGK_SSDP 1                  // answer SSDP discovery
+#endif
+#endif
+#ifndef ESPSIGK_DELTA_PAGE
+#define ESPSIGK_DELTA_PAGE 1            // serve the "last delta" web page
+#endif
+
+#ifndef ESPSIGK_REST_API
+#define ESPSIGK_REST_API 1              // last value of every path at /signalk/v1/api/vessels/self
+#endif
+
+#ifndef ESPSIGK_NETWORK_TASK
+#if defined(ESP32) && !CONFIG_FREERTOS_UNICORE
+#define ESPSIGK_NETWORK_TASK 1          // websocket/HTTP in their own task, see EspSigKPlatform.h
+#else
+#define ESPSIGK_NETWORK_TASK 0
+#endif
+#endif
+#ifndef NETWORK_TASK_CORE
+#define NETWORK_TASK_CORE 0             // the core running the WiFi stack, loop() runs on 1
+#endif
+#ifndef NETWORK_TASK_STACK
+#define NETWORK_TASK_STACK 8192
+#endif
+#ifndef NETWORK_TASK_PRIORITY
+#define NETWORK_TASK_PRIORITY 1
+#endif
+#ifndef NETWORK_TASK_POLL_INTERVAL
+#define NETWORK_TASK_POLL_INTERVAL 5    // ms between HTTP/websocket polls when no delta is waiting
+#endif
+#ifndef FRAME_QUEUE_DEPTH
+#if ESPSIGK_NETWORK_TASK
+#define FRAME_QUEUE_DEPTH 4             // deltas waiting for the network task
+#else
+#define FRAME_QUEUE_DEPTH 1             // sent right away from sendDelta()
+#endif
+#endif
+
+#ifndef ESPSIGK_RECORDER
+#define ESPSIGK_RECORDER 0              // record sent deltas to LittleFS
+#endif
+#ifndef RECORDER_BUFFER_SIZE
+#define RECORDER_BUFFER_SIZE 512        // bytes collected in RAM before a flash write
+#endif
+#ifndef RECORDER_FLUSH_INTERVAL
+#define RECORDER_FLUSH_INTERVAL 30000   // ms, longest time records stay in RAM
+#endif
+#ifndef RECORDER_SEGMENT_SIZE
+#define RECORDER_SEGMENT_SIZE 65536     // bytes per log file before starting a new one
+#endif
+#ifndef RECORDER_SEGMENTS
+#define RECORDER_SEGMENTS 8             // log files kept, the oldest is deleted
+#endif
+
+#ifndef ESPSIGK_LATENCY
+#define ESPSIGK_LATENCY 0               // latency histograms and websocket ping probes
+#endif
+#ifndef LATENCY_BUCKETS
+#define LATENCY_BUCKETS 24              // log2 buckets from 1 us, the last one holds everything above ~8 s
+#endif
+#ifndef LATENCY_PING_INTERVAL
+#define LATENCY_PING_INTERVAL 5000      // ms between websocket round trip probes
+#endif
+#ifndef LATENCY_REPORT_INTERVAL
+#define LATENCY_REPORT_INTERVAL 60000   // ms between latency diagnostic deltas, 0 for none
+#endif
+
+static_assert(MAX_DELTA_VALUES > 0 && MAX_DELTA_VALUES <= 255, "MAX_DELTA_VALUES must fit in a uint8_t");
+static_assert(FRAME_QUEUE_DEPTH > 0, "FRAME_QUEUE_DEPTH must be at least 1");
+static_assert(MAX_PATHS > 0 && MAX_PATHS < 255, "MAX_PATHS must fit in a path handle");
+static_assert(PATH_TABLE_SIZE > 0 && PATH_TABLE_SIZE <= 65535, "PATH_TABLE_SIZE must fit in a uint16_t");
+static_assert(DELTA_FRAME_SIZE >= DELTA_FRAME_WORST_CASE, "DELTA_FRAME_SIZE can't hold MAX_DELTA_VALUES paths of MAX_DELTA_PATH_LENGTH");
+static_assert(LATENCY_BUCKETS >= 2 && LATENCY_BUCKETS <= 32, "LATENCY_BUCKETS must be 2 to 32");
+
+/*
+ * The capacities of an EspSigK node. A sketch sizes its own by deriving from this
+ * and hiding what it changes, BasicEspSigK checks the result at compile time:
+ *
+ *   struct SmallNode : EspSigKDefaultConfig {
+ *     static const uint8_t maxDeltaValues = 2;
+ *     static const uint8_t maxPaths = 4;
+ *     static const uint16_t pathTableSize = 4 * 40;
+ *     static const size_t deltaFrameSize = espSigKDeltaFrameWorstCase(maxHostnameLength, maxDeltaValues, maxDeltaPathLength);
+ *   };
+ *   BasicEspSigK<SmallNode> sigK(hostname, ssid, ssidPass, &wiFiClient);
+ */
+struct EspSigKDefaultConfig {
+  static const uint8_t maxDeltaValues = MAX_DELTA_VALUES;
+  static const size_t maxDeltaPathLength = MAX_DELTA_PATH_LENGTH;
+  static const size_t maxHostnameLength = MAX_HOSTNAME_LENGTH;
+  static const uint8_t maxPaths = MAX_PATHS;
+  static const uint16_t pathTableSize = PATH_TABLE_SIZE;
+  static const size_t deltaFrameSize = DELTA_FRAME_SIZE;      // at least the worst case of the sizes above
+  static const size_t frameQueueDepth = FRAME_QUEUE_DEPTH;
+  static const uint8_t maxMetaPaths = MAX_META_PATHS;
+};
+
+#endif
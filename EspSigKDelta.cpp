@@ -0,0 +1,74 @@
+#include "EspSigKDelta.h"
+
+#include <math.h>
+#include <stdarg.h>
+
+// Appends to a fixed buffer, remembers when something didn't fit
+class EspSigKFrameWriter
+{
+  public:
+    EspSigKFrameWriter(char * frame, size_t size) : frame(frame), size(size), length(0), overflowed(false) {}
+
+    void write(const char * text, size_t len) {
+      if (len > size - length) {
+        overflowed = true;
+        return;
+      }
+      memcpy(frame + length, text, len);
+      length += len;
+    }
+    void print(const char * text) { write(text, strlen(text)); }
+    void printf(const char * format, ...) __attribute__((format(printf, 2, 3))) {
+      char text[32];
+      va_list args;
+      va_start(args, format);
+      int len = vsnprintf(text, sizeof(text), format, args);
+      va_end(args);
+      if (len < 0 || len >= (int)sizeof(text)) overflowed = true;
+      else write(text, len);
+    }
+    // quoted, with ", \ and control characters escaped
+    void printString(const char * text) {
+      write("\"", 1);
+      for (const char * c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+          char escaped[2] = { '\\', *c };
+          write(escaped, 2);
+        } else if ((uint8_t)*c < 0x20) {
+          printf("\\u%04x", (uint8_t)*c);
+        } else {
+          write(c, 1);
+        }
+      }
+      write("\"", 1);
+    }
+
+    char * frame;
+    size_t size;
+    size_t length;
+    bool overflowed;
+};
+
+size_t serializeDelta(const char * source, const deltaValue * values, const char * valuePaths, size_t pathStride,
+                      uint8_t count, char * frame, size_t size) {
+  EspSigKFrameWriter out(frame, size);
+
+  out.print("{\"updates\":[{\"source\":{\"label\":\"ESP\",\"src\":");
+  out.printString(source);
+  out.print("},\"values\":[");
+  for (uint8_t i = 0; i < count; i++) {
+    if (i > 0) out.print(",");
+    out.print("{\"path\":");
+    out.printString(valuePaths + i * pathStride);
+    out.print(",\"value\":");
+    switch (values[i].type) {
+      case DELTA_VALUE_INT:    out.printf("%d", values[i].i); break;
+      case DELTA_VALUE_DOUBLE: isfinite(values[i].d) ? out.printf("%.10g", values[i].d) : out.print("null"); break;
+      case DELTA_VALUE_BOOL:   out.print(values[i].b ? "true" : "false"); break;
+    }
+    out.print("}");
+  }
+  out.print("]}]}");
+
+  return out.overflowed ? 0 : out.length;
+}
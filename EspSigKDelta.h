@@ -0,0 +1,20 @@
+#ifndef EspSigKDelta_H
+#define EspSigKDelta_H
+
+#include <Arduino.h>
+
+#include "EspSigKPaths.h"
+
+/*
+ * Serializes a delta straight into a frame:
+ *   {"updates":[{"source":{"label":"ESP","src":"<source>"},"values":[{"path":"<path>","value":<value>},...]}]}
+ * Strings are escaped, doubles written with 10 significant digits (null when not
+ * finite), like the REST API. The value i's path is at valuePaths + i * pathStride.
+ *
+ * Returns the length (the frame is not terminated), 0 if the delta doesn't fit in size.
+ * Needs nothing from the ESP, extras/sigkload builds it on the host.
+ */
+size_t serializeDelta(const char * source, const deltaValue * values, const char * valuePaths, size_t pathStride,
+                      uint8_t count, char * frame, size_t size);
+
+#endif
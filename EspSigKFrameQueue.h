@@ -0,0 +1,85 @@
+#ifndef EspSigKFrameQueue_H
+#define EspSigKFrameQueue_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "EspSigKConfig.h"
+
+// a queued frame, the times are micros() for latency tracing (0 when not traced)
+struct frameInfo {
+  size_t length;
+  uint32_t capturedMicros;      // first addDeltaValue() of the delta
+  uint32_t serializedMicros;    // delta serialized into the frame
+};
+
+/*
+ * Serialized deltas on their way to the websocket. Single producer (sendDelta())
+ * single consumer (the network side), lock free: the producer serializes straight
+ * into the slot from reserve() and publishes it with commit(), the consumer reads
+ * with peek() and hands the slot back with release(). When the queue is full the
+ * delta is dropped and counted, sendDelta() never waits for the network.
+ * The frames belong to the owner, EspSigKStaticFrameQueue or BasicEspSigK's config.
+ */
+class EspSigKFrameQueue
+{
+  public:
+    // depth frames of frameSize bytes, with their infos
+    EspSigKFrameQueue(char * frames, frameInfo * infos, size_t depth, size_t frameSize)
+      : frames(frames), infos(infos), depth(depth), frameSize(frameSize), head(0), tail(0), dropped(0) {}
+
+    // producer
+    char * reserve() {
+      uint32_t h = head.load(std::memory_order_relaxed);
+      if (h - tail.load(std::memory_order_acquire) >= depth) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return NULL;
+      }
+      return frames + (h % depth) * frameSize;
+    }
+    void commit(const frameInfo &info) {
+      uint32_t h = head.load(std::memory_order_relaxed);
+      infos[h % depth] = info;
+      head.store(h + 1, std::memory_order_release);
+    }
+    size_t getFrameSize() { return frameSize; }
+
+    // consumer
+    const char * peek(frameInfo &info) {
+      uint32_t t = tail.load(std::memory_order_relaxed);
+      if (t == head.load(std::memory_order_acquire)) return NULL;
+      info = infos[t % depth];
+      return frames + (t % depth) * frameSize;
+    }
+    void release() {
+      tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    uint32_t getDropped() { return dropped.load(std::memory_order_relaxed); }
+
+  private:
+    char * const frames;
+    frameInfo * const infos;
+    const size_t depth;
+    const size_t frameSize;
+    std::atomic<uint32_t> head;     // frames committed, written by the producer only
+    std::atomic<uint32_t> tail;     // frames released, written by the consumer only
+    std::atomic<uint32_t> dropped;
+};
+
+// A frame queue with its frames inside, sized at compile time
+template<size_t DEPTH = FRAME_QUEUE_DEPTH, size_t FRAME_SIZE = DELTA_FRAME_SIZE>
+class EspSigKStaticFrameQueue : public EspSigKFrameQueue
+{
+  public:
+    EspSigKStaticFrameQueue() : EspSigKFrameQueue(frameStorage[0], infoStorage, DEPTH, FRAME_SIZE) {}
+
+  private:
+    static_assert(DEPTH > 0, "the frame queue needs at least one frame");
+
+    char frameStorage[DEPTH][FRAME_SIZE];
+    frameInfo infoStorage[DEPTH];
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "EspSigKHttpClient.h"
+
+EspSigKHttpClient::EspSigKHttpClient(WiFiClient * client) : client(client), keepAlive(false)
+{
+}
+
+int EspSigKHttpClient::request(const char * host, uint16_t port, const char * method, const char * urlPath, const char * jsonPayload,
+                               char * body, size_t size, int32_t &bodyLength) {
+  int32_t contentLength;
+  bool chunked;
+  bool serverKeepAlive;
+  int status;
+
+  while (true) {
+    bool reused = keepAlive && client->connected();
+    if (!reused && !connect(host, port)) {
+      return HTTP_ERROR_CONNECT;
+    }
+
+    int error = sendRequest(host, port, method, urlPath, jsonPayload);
+    if (error == HTTP_ERROR_REQUEST_TOO_LONG) {
+      return error;
+    }
+    if (error < 0) {
+      close();
+      if (reused) continue;
+      return HTTP_ERROR_WRITE;
+    }
+
+    status = readResponseHead(contentLength, chunked, serverKeepAlive);
+    if (status < 0) {
+      close();
+      if (reused) continue;
+      return HTTP_ERROR_RESPONSE;
+    }
+    break;
+  }
+
+  bodyLength = readBody(body, size, contentLength, chunked);
+  if (bodyLength < 0) {
+    close();
+    return bodyLength == -2 ? HTTP_ERROR_BODY_TOO_LARGE : HTTP_ERROR_BODY;
+  }
+
+  // without a length the body ended with the connection
+  if (serverKeepAlive && (contentLength >= 0 || chunked)) {
+    keepAlive = true;
+  } else {
+    close();
+  }
+  return status;
+}
+
+bool EspSigKHttpClient::connect(const char * host, uint16_t port) {
+  close();
+#if defined(ESP32)
+  return client->connect(host, port, HTTP_CONNECT_TIMEOUT);
+#else
+  client->setTimeout(HTTP_CONNECT_TIMEOUT);
+  return client->connect(host, port);
+#endif
+}
+
+void EspSigKHttpClient::close() {
+  client->stop();
+  keepAlive = false;
+}
+
+// Returns 0 when the request was written, or HTTP_ERROR_*
+int EspSigKHttpClient::sendRequest(const char * host, uint16_t port, const char * method, const char * urlPath, const char * jsonPayload) {
+  char request[HTTP_REQUEST_BUFFER_SIZE];
+  size_t payloadLength = strlen(jsonPayload);
+  int len;
+
+  if (payloadLength > 0) {
+    len = snprintf(request, sizeof(request),
+                   "%s %s HTTP/1.1\r\nHost: %s:%u\r\nConnection: keep-alive\r\n"
+                   "Content-Type: application/json\r\nContent-Length: %u\r\n\r\n",
+                   method, urlPath, host, port, (unsigned int)payloadLength);
+  } else {
+    len = snprintf(request, sizeof(request),
+                   "%s %s HTTP/1.1\r\nHost: %s:%u\r\nConnection: keep-alive\r\n\r\n",
+                   method, urlPath, host, port);
+  }
+  if (len < 0 || (size_t)len >= sizeof(request)) {
+    return HTTP_ERROR_REQUEST_TOO_LONG;
+  }
+
+  if (client->write((const uint8_t *)request, len) != (size_t)len) {
+    return HTTP_ERROR_WRITE;
+  }
+  if (payloadLength > 0 && client->write((const uint8_t *)jsonPayload, payloadLength) != payloadLength) {
+    return HTTP_ERROR_WRITE;
+  }
+  return 0;
+}
+
+// Reads status line and headers. Returns the HTTP status, or -1 on timeout/malformed response.
+// contentLength is -1 when the server did not send one.
+int EspSigKHttpClient::readResponseHead(int32_t &contentLength, bool &chunked, bool &serverKeepAlive) {
+  char line[HTTP_HEADER_LINE_LENGTH];
+  uint32_t deadline = millis() + HTTP_RESPONSE_TIMEOUT;
+
+  contentLength = -1;
+  chunked = false;
+
+  // "HTTP/1.1 200 OK"
+  if (!readLine(line, sizeof(line), deadline)) return -1;
+  if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12 || line[8] != ' ') return -1;
+  serverKeepAlive = (line[7] != '0'); // HTTP/1.0 closes unless told otherwise
+  int status = atoi(line + 9);
+  if (status < 100 || status > 599) return -1;
+
+  while (true) {
+    if (!readLine(line, sizeof(line), deadline)) return -1;
+    if (line[0] == '\0') break; // end of headers
+
+    char * value = strchr(line, ':');
+    if (value == NULL) continue;
+    *value++ = '\0';
+    while (*value == ' ' || *value == '\t') value++;
+
+    if (strcasecmp(line, "Content-Length") == 0) {
+      contentLength = atol(value);
+    } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+      chunked = (strncasecmp(value, "chunked", 7) == 0);
+    } else if (strcasecmp(line, "Connection") == 0) {
+      if (strncasecmp(value, "close", 5) == 0) serverKeepAlive = false;
+      if (strncasecmp(value, "keep-alive", 10) == 0) serverKeepAlive = true;
+    }
+  }
+  return status;
+}
+
+// Reads the response body into body. Returns its length, -1 on timeout or -2 if it does not fit.
+int32_t EspSigKHttpClient::readBody(char * body, size_t size, int32_t contentLength, bool chunked) {
+  uint32_t deadline = millis() + HTTP_RESPONSE_TIMEOUT;
+  size_t len = 0;
+  bool overflow = false;
+  int c;
+
+  if (chunked) {
+    char line[HTTP_HEADER_LINE_LENGTH];
+    while (true) {
+      if (!readLine(line, sizeof(line), deadline)) return -1;
+      long chunkSize = strtol(line, NULL, 16);
+      if (chunkSize <= 0) break;
+      for (long i = 0; i < chunkSize; i++) {
+        if ((c = readByte(deadline)) < 0) return -1;
+        if (len < size) { body[len++] = (char)c; } else { overflow = true; }
+      }
+      if (!readLine(line, sizeof(line), deadline)) return -1; // CRLF after chunk data
+    }
+    // skip trailers
+    do {
+      if (!readLine(line, sizeof(line), deadline)) return -1;
+    } while (line[0] != '\0');
+  } else {
+    // without Content-Length the body ends when the server closes the connection
+    for (int32_t i = 0; contentLength < 0 || i < contentLength; i++) {
+      if ((c = readByte(deadline)) < 0) {
+        if (contentLength < 0) break;
+        return -1;
+      }
+      if (len < size) { body[len++] = (char)c; } else { overflow = true; }
+    }
+  }
+
+  return overflow ? -2 : (int32_t)len;
+}
+
+bool EspSigKHttpClient::readLine(char * line, size_t size, uint32_t deadline) {
+  size_t len = 0;
+  int c;
+
+  while ((c = readByte(deadline)) != '\n') {
+    if (c < 0) return false;
+    if (c != '\r' && len < size - 1) line[len++] = (char)c; // overlong lines are truncated
+  }
+  line[len] = '\0';
+  return true;
+}
+
+int EspSigKHttpClient::readByte(uint32_t deadline) {
+  while (!client->available()) {
+    if (!client->connected() || (int32_t)(millis() - deadline) >= 0) {
+      return -1;
+    }
+    delay(1);
+  }
+  return client->read();
+}
@@ -0,0 +1,61 @@
+#ifndef EspSigKHttpClient_H
+#define EspSigKHttpClient_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include "EspSigKConfig.h"
+
+#ifndef HTTP_REQUEST_BUFFER_SIZE
+#define HTTP_REQUEST_BUFFER_SIZE 384    // request line and headers
+#endif
+#ifndef HTTP_HEADER_LINE_LENGTH
+#define HTTP_HEADER_LINE_LENGTH 128     // longer response header lines are truncated
+#endif
+#ifndef HTTP_CONNECT_TIMEOUT
+#define HTTP_CONNECT_TIMEOUT 3000       // ms
+#endif
+#ifndef HTTP_RESPONSE_TIMEOUT
+#define HTTP_RESPONSE_TIMEOUT 5000      // ms for the head, and again for the body
+#endif
+
+// returned by request() instead of an HTTP status
+#define HTTP_ERROR_CONNECT -1
+#define HTTP_ERROR_WRITE -2
+#define HTTP_ERROR_REQUEST_TOO_LONG -3
+#define HTTP_ERROR_RESPONSE -4      // timeout or malformed status line/headers
+#define HTTP_ERROR_BODY -5          // timeout
+#define HTTP_ERROR_BODY_TOO_LARGE -6
+
+/*
+ * Minimal HTTP/1.1 client for the access request polls, on the sketch's WiFiClient.
+ * Requests are formatted into a fixed buffer, the response is read with a deadline
+ * into the caller's buffer. The connection is kept open between requests when the
+ * server allows it, a request failing on a reused connection is retried once on a
+ * fresh one (the server may have closed it while idle).
+ *
+ * Only uses the WiFiClient interface, extras/httpclient_test.cpp runs it on the host.
+ */
+class EspSigKHttpClient
+{
+  public:
+    EspSigKHttpClient(WiFiClient * client);
+    // Returns the HTTP status or HTTP_ERROR_*, the body is not terminated
+    int request(const char * host, uint16_t port, const char * method, const char * urlPath, const char * jsonPayload,
+                char * body, size_t size, int32_t &bodyLength);
+    void close();
+    bool isKeptAlive() { return keepAlive; }
+
+  private:
+    bool connect(const char * host, uint16_t port);
+    int sendRequest(const char * host, uint16_t port, const char * method, const char * urlPath, const char * jsonPayload);
+    int readResponseHead(int32_t &contentLength, bool &chunked, bool &serverKeepAlive);
+    int32_t readBody(char * body, size_t size, int32_t contentLength, bool chunked);
+    bool readLine(char * line, size_t size, uint32_t deadline);
+    int readByte(uint32_t deadline);
+
+    WiFiClient * client;
+    bool keepAlive;         // server allowed us to reuse the connection for the next request
+};
+
+#endif
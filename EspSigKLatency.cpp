@@ -0,0 +1,44 @@
+#include "EspSigKLatency.h"
+
+#if ESPSIGK_LATENCY
+
+void EspSigKHistogram::add(uint32_t micros) {
+  uint8_t bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && (micros >> (bucket + 1)) != 0) bucket++;
+  buckets[bucket]++;
+  count++;
+  sum += micros;
+  if (micros > max) max = micros;
+}
+
+void EspSigKHistogram::reset() {
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  max = 0;
+  sum = 0;
+}
+
+uint32_t EspSigKHistogram::getPercentile(uint8_t percent) {
+  if (count == 0) return 0;
+  uint32_t target = ((uint64_t)count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      uint32_t upper = ((uint32_t)2 << i) - 1;
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+void EspSigKLatency::reset() {
+  captureToSerialize.reset();
+  serializeToSend.reset();
+  captureToSend.reset();
+  roundTrip.reset();
+  pingsSent = 0;
+  pingsLost = 0;
+}
+
+#endif
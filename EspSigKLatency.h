@@ -0,0 +1,55 @@
+#ifndef EspSigKLatency_H
+#define EspSigKLatency_H
+
+#include "EspSigKConfig.h"
+
+#if ESPSIGK_LATENCY
+
+#include <Arduino.h>
+
+/*
+ * Latency histogram in microseconds with fixed log2 buckets: bucket 0 counts
+ * samples below 2 us, bucket i samples from 2^i to 2^(i+1) - 1 us, the last
+ * bucket everything above. add() is called from one side only (producer or
+ * network), readers may see a sample half added, which is fine for diagnostics.
+ */
+class EspSigKHistogram
+{
+  public:
+    EspSigKHistogram() { reset(); }
+    void add(uint32_t micros);
+    void reset();
+
+    uint32_t getCount() { return count; }
+    uint32_t getMax() { return max; }
+    uint32_t getMean() { return count > 0 ? (uint32_t)(sum / count) : 0; }
+    uint32_t getBucket(uint8_t i) { return buckets[i]; }
+    uint32_t getPercentile(uint8_t percent);    // upper end of the bucket, at most getMax()
+
+  private:
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+};
+
+/*
+ * Where the time goes between addDeltaValue() and the wire, and the websocket
+ * round trip. Per delta, the time of its first addDeltaValue() (capture), the end of
+ * serializing it in sendDelta() and the return of webSocketClient.send() (handed to
+ * the TCP stack). The round trip is a websocket ping until its pong was read.
+ */
+struct EspSigKLatency {
+  EspSigKHistogram captureToSerialize;   // sampling and building the delta, producer side
+  EspSigKHistogram serializeToSend;      // frame queue and socket send, network side
+  EspSigKHistogram captureToSend;        // the whole way, network side
+  EspSigKHistogram roundTrip;            // ping to pong, network side
+  uint32_t pingsSent;
+  uint32_t pingsLost;                    // no pong before the next ping or a disconnect
+
+  void reset();
+};
+
+#endif
+
+#endif
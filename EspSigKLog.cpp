@@ -0,0 +1,86 @@
+#include "EspSigKLog.h"
+
+#define SERIAL_DEBUG_MESSAGE_PREFIX "SigK: "
+
+static char espSigKLogBuffer[ESPSIGK_LOG_BUFFER_SIZE];
+EspSigKLog espSigKLog(Serial, espSigKLogBuffer, sizeof(espSigKLogBuffer));
+
+EspSigKLog::EspSigKLog(Print &out, char * buffer, size_t size) : out(out), buffer(buffer), size(size)
+{
+  head = 0;
+  tail = 0;
+  used = 0;
+  dropped = 0;
+  droppedReported = 0;
+  enabled = false;
+}
+
+void EspSigKLog::setEnabled(bool v) {
+  enabled = v;
+}
+
+void EspSigKLog::log(uint8_t level, PGM_P format, ...) {
+  static const char levelNames[] = "-EWID";
+  char line[ESPSIGK_LOG_LINE_LENGTH];
+  va_list args;
+
+  int len = snprintf(line, sizeof(line), SERIAL_DEBUG_MESSAGE_PREFIX "%c ", levelNames[level <= ESPSIGK_LOG_DEBUG ? level : 0]);
+  va_start(args, format);
+  int n = vsnprintf_P(line + len, sizeof(line) - len, format, args);
+  va_end(args);
+  if (n < 0) return;
+  len += min((size_t)n, sizeof(line) - len - 1); // long messages are truncated
+
+  push(line, len);
+}
+
+// Queues text plus a line break, used for deltas which don't get the log prefix
+bool EspSigKLog::writeLine(const char * text, size_t length) {
+  return push(text, length);
+}
+
+// Sends as much of the buffer as the UART takes without blocking. Called from handle().
+void EspSigKLog::drain() {
+  EspSigKLock lock(mutex);
+  while (used > 0) {
+    int room = out.availableForWrite();
+    if (room <= 0) return;
+
+    size_t chunk = min(used, size - tail);
+    chunk = min(chunk, (size_t)room);
+    out.write((const uint8_t *)buffer + tail, chunk);
+    tail = (tail + chunk) % size;
+    used -= chunk;
+  }
+}
+
+// Whole lines only: either the line and its line break fit, or it is dropped
+bool EspSigKLog::push(const char * text, size_t length) {
+  EspSigKLock lock(mutex);
+  if (dropped != droppedReported) {
+    char note[48];
+    int noteLength = snprintf(note, sizeof(note), SERIAL_DEBUG_MESSAGE_PREFIX "%u log lines dropped\r\n", (unsigned int)(dropped - droppedReported));
+    if (size - used < noteLength + length + 2) {
+      dropped++;
+      return false;
+    }
+    copyIn(note, noteLength);
+    droppedReported = dropped;
+  }
+
+  if (size - used < length + 2) {
+    dropped++;
+    return false;
+  }
+  copyIn(text, length);
+  copyIn("\r\n", 2);
+  return true;
+}
+
+void EspSigKLog::copyIn(const char * data, size_t length) {
+  size_t first = min(length, size - head);
+  memcpy(buffer + head, data, first);
+  memcpy(buffer, data + first, length - first);
+  head = (head + length) % size;
+  used += length;
+}
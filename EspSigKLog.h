@@ -0,0 +1,91 @@
+#ifndef EspSigKLog_H
+#define EspSigKLog_H
+
+#include <Arduino.h>
+
+#include "EspSigKPlatform.h"
+
+/*
+ * Debug output goes through a fixed ring buffer that handle() drains into
+ * Serial only as fast as the UART can take it, so turning on debug or delta
+ * printing doesn't change the timing of the loop being debugged. When the
+ * buffer is full messages are dropped (and counted) instead of blocking.
+ *
+ * Messages above ESPSIGK_LOG_LEVEL are compiled out, format strings stay in flash.
+ */
+
+#define ESPSIGK_LOG_NONE 0
+#define ESPSIGK_LOG_ERROR 1
+#define ESPSIGK_LOG_WARN 2
+#define ESPSIGK_LOG_INFO 3
+#define ESPSIGK_LOG_DEBUG 4
+
+#ifndef ESPSIGK_LOG_LEVEL
+#define ESPSIGK_LOG_LEVEL ESPSIGK_LOG_DEBUG
+#endif
+#ifndef ESPSIGK_LOG_BUFFER_SIZE
+// at least one full delta of the default config for setPrintDeltaSerial(), with room for some debug
+// lines next to it. Printed deltas that don't fit (larger configs) are dropped and counted.
+#define ESPSIGK_LOG_BUFFER_SIZE (DELTA_FRAME_SIZE + 256 > 1024 ? DELTA_FRAME_SIZE + 256 : 1024)
+#endif
+#ifndef ESPSIGK_LOG_LINE_LENGTH
+#define ESPSIGK_LOG_LINE_LENGTH 128
+#endif
+
+static_assert(ESPSIGK_LOG_BUFFER_SIZE > DELTA_FRAME_SIZE + 2, "ESPSIGK_LOG_BUFFER_SIZE can't hold a printed delta (DELTA_FRAME_SIZE + line break)");
+
+class EspSigKLog
+{
+  public:
+    EspSigKLog(Print &out, char * buffer, size_t size);
+    void setEnabled(bool v);
+    bool isEnabled() { return enabled; }
+
+    void log(uint8_t level, PGM_P format, ...) __attribute__((format(printf, 3, 4)));
+    bool writeLine(const char * text, size_t length);
+    void drain();
+    uint32_t getDropped() { return dropped; }
+
+  private:
+    bool push(const char * text, size_t length);
+    void copyIn(const char * data, size_t length);
+
+    Print &out;
+    EspSigKMutex mutex;     // loop() and the network task both log
+    char * const buffer;    // ESPSIGK_LOG_BUFFER_SIZE bytes in EspSigKLog.cpp, outside the sketch's view of the class
+    const size_t size;
+    size_t head;            // next byte written
+    size_t tail;            // next byte sent to out
+    size_t used;
+    uint32_t dropped;
+    uint32_t droppedReported;
+    bool enabled;
+};
+
+extern EspSigKLog espSigKLog;
+
+#define SIGK_LOG(level, format, ...) \
+  do { if (espSigKLog.isEnabled()) espSigKLog.log(level, PSTR(format), ##__VA_ARGS__); } while (0)
+
+#if ESPSIGK_LOG_LEVEL >= ESPSIGK_LOG_ERROR
+#define SIGK_ERROR(format, ...) SIGK_LOG(ESPSIGK_LOG_ERROR, format, ##__VA_ARGS__)
+#else
+#define SIGK_ERROR(format, ...) do {} while (0)
+#endif
+#if ESPSIGK_LOG_LEVEL >= ESPSIGK_LOG_WARN
+#define SIGK_WARN(format, ...) SIGK_LOG(ESPSIGK_LOG_WARN, format, ##__VA_ARGS__)
+#else
+#define SIGK_WARN(format, ...) do {} while (0)
+#endif
+#if ESPSIGK_LOG_LEVEL >= ESPSIGK_LOG_INFO
+#define SIGK_INFO(format, ...) SIGK_LOG(ESPSIGK_LOG_INFO, format, ##__VA_ARGS__)
+#else
+#define SIGK_INFO(format, ...) do {} while (0)
+#endif
+#if ESPSIGK_LOG_LEVEL >= ESPSIGK_LOG_DEBUG
+#define SIGK_DEBUG(format, ...) SIGK_LOG(ESPSIGK_LOG_DEBUG, format, ##__VA_ARGS__)
+#else
+#define SIGK_DEBUG(format, ...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#include "EspSigKPaths.h"
+
+EspSigKPathTable::EspSigKPathTable(char * text, uint16_t textSize, uint16_t * offsets, uint8_t maxPaths, uint8_t * slots)
+  : text(text), textSize(textSize), offsets(offsets), maxPaths(maxPaths), slots(slots), slotMask(pathHashSlots(maxPaths) - 1)
+{
+  memset(slots, 0, slotMask + 1);
+  textUsed = 0;
+  used = 0;
+}
+
+// FNV-1a, then linear probing. Returns the slot holding path or the empty slot where it belongs.
+uint16_t EspSigKPathTable::probe(const char * path) {
+  uint32_t hash = 2166136261u;
+  for (const char * c = path; *c; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+
+  uint16_t slot = hash & slotMask;
+  while (slots[slot] != 0 && strcmp(get(slots[slot] - 1), path) != 0) {
+    slot = (slot + 1) & slotMask;
+  }
+  return slot;
+}
+
+uint8_t EspSigKPathTable::find(const char * path) {
+  uint16_t slot = probe(path);
+  return slots[slot] == 0 ? PATH_HANDLE_NONE : slots[slot] - 1;
+}
+
+uint8_t EspSigKPathTable::intern(const char * path) {
+  uint16_t slot = probe(path);
+  if (slots[slot] != 0) {
+    return slots[slot] - 1;
+  }
+  uint32_t handle = used.load(std::memory_order_relaxed);
+  size_t length = strlen(path) + 1;
+  if (handle >= maxPaths || length > (size_t)(textSize - textUsed)) {
+    return PATH_HANDLE_NONE;
+  }
+
+  memcpy(text + textUsed, path, length);
+  offsets[handle] = textUsed;
+  textUsed += length;
+  slots[slot] = handle + 1;
+  used.store(handle + 1, std::memory_order_release);   // the path is complete before readers see the handle
+  return handle;
+}
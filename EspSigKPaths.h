@@ -0,0 +1,87 @@
+#ifndef EspSigKPaths_H
+#define EspSigKPaths_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "EspSigKConfig.h"
+
+#define PATH_HANDLE_NONE 0xFF
+
+// Smallest power of two that keeps the path hash table at most half full
+constexpr uint16_t pathHashSlots(uint8_t maxPaths, uint16_t n = 1) { return n >= 2 * maxPaths ? n : pathHashSlots(maxPaths, n * 2); }
+
+/*
+ * Paths the REST API, the meta and the recorder keep state for, each stored
+ * once and referred to by a one byte handle, handed out in order of first use.
+ * Lookup by name is a hash probe. Paths are never removed: once maxPaths paths
+ * (or textSize bytes of them) are in use, intern() has no handle for a new one. Sending doesn't depend on the table, every delta slot carries its
+ * own copy of the path.
+ *
+ * Only loop() adds paths. The network task (htmlApi(), sendMeta()) reads them
+ * without a lock: intern() writes the path before publishing the new count with
+ * release, count() loads it with acquire, and a handle below count() never changes.
+ */
+class EspSigKPathTable
+{
+  public:
+    // text holds textSize bytes of paths, offsets maxPaths entries, slots pathHashSlots(maxPaths)
+    EspSigKPathTable(char * text, uint16_t textSize, uint16_t * offsets, uint8_t maxPaths, uint8_t * slots);
+    uint8_t intern(const char * path);     // handle of path, added if new. PATH_HANDLE_NONE if full
+    uint8_t find(const char * path);       // handle of path or PATH_HANDLE_NONE
+    const char * get(uint8_t handle) { return text + offsets[handle]; }
+    uint8_t count() { return used.load(std::memory_order_acquire); }
+    uint8_t capacity() { return maxPaths; }
+
+  private:
+    uint16_t probe(const char * path);
+
+    char * const text;                     // the paths, one after the other
+    const uint16_t textSize;
+    uint16_t * const offsets;              // of each handle's path in text
+    const uint8_t maxPaths;
+    uint8_t * const slots;                 // handle + 1, 0 is empty
+    const uint16_t slotMask;
+    uint16_t textUsed;
+    std::atomic<uint32_t> used;            // handles published, written by intern() only
+};
+
+// A path table with its text inside, sized at compile time
+template<uint8_t MAX_PATH_COUNT, uint16_t TEXT_SIZE>
+class EspSigKStaticPathTable : public EspSigKPathTable
+{
+  public:
+    EspSigKStaticPathTable() : EspSigKPathTable(textStorage, TEXT_SIZE, offsetStorage, MAX_PATH_COUNT, slotStorage) {}
+
+  private:
+    static_assert(MAX_PATH_COUNT > 0 && MAX_PATH_COUNT < PATH_HANDLE_NONE, "maxPaths must be 1 to 254, a path handle is one byte");
+    static_assert(TEXT_SIZE > 0, "the path table needs room for path text");
+
+    char textStorage[TEXT_SIZE];
+    uint16_t offsetStorage[MAX_PATH_COUNT];
+    uint8_t slotStorage[pathHashSlots(MAX_PATH_COUNT)];
+};
+
+enum deltaValueType : uint8_t {
+  DELTA_VALUE_INT,
+  DELTA_VALUE_DOUBLE,
+  DELTA_VALUE_BOOL
+};
+
+struct deltaValue {
+  uint8_t pathHandle;       // PATH_HANDLE_NONE when the path isn't in the table
+  deltaValueType type;
+  union {
+    int i;
+    double d;
+    bool b;
+  };
+};
+
+// Last value added for a path, kept for the REST API
+struct cachedValue {
+  deltaValue value;
+  uint32_t capturedMillis;
+  bool valid;
+};
+
+#endif
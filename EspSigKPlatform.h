@@ -0,0 +1,78 @@
+#ifndef EspSigKPlatform_H
+#define EspSigKPlatform_H
+
+/*
+ * Board specific headers and types, everything else in the library is shared.
+ *
+ * On a dual core ESP32 the websocket, HTTP server and reconnects run in their
+ * own FreeRTOS task on the core the WiFi stack uses, and sendDelta() only hands
+ * the serialized delta over through EspSigKFrameQueue. On the ESP8266 all of it
+ * still runs from handle().
+ */
+
+#include "EspSigKConfig.h"
+
+#if defined(ESP32)
+
+#include <WiFi.h>
+#include <ESPmDNS.h>
+#include <WebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#if ESPSIGK_SSDP
+#include <ESP32SSDP.h>          // https://github.com/luc-github/ESP32SSDP
+#endif
+
+typedef WebServer EspSigKWebServer;
+
+#elif defined(ESP8266)
+
+extern "C" {
+  #include "user_interface.h"
+}
+#include <ESP8266WiFi.h>        // ESP8266 Core WiFi Library (you most likely already have this in your sketch)
+#include <ESP8266mDNS.h>        // Include the mDNS library
+#include <ESP8266WebServer.h>   // Local WebServer used to serve the configuration portal
+#if ESPSIGK_SSDP
+#include <ESP8266SSDP.h>
+#endif
+
+typedef ESP8266WebServer EspSigKWebServer;
+
+#else
+#error "EspSigK supports ESP8266 and ESP32"
+#endif
+
+// Guards state shared between the network task and the sketch's loop(). No-op without the network task.
+#if ESPSIGK_NETWORK_TASK
+class EspSigKMutex
+{
+  public:
+    EspSigKMutex() { handle = xSemaphoreCreateMutex(); }
+    void lock() { xSemaphoreTake(handle, portMAX_DELAY); }
+    void unlock() { xSemaphoreGive(handle); }
+
+  private:
+    SemaphoreHandle_t handle;
+};
+#else
+class EspSigKMutex
+{
+  public:
+    void lock() {}
+    void unlock() {}
+};
+#endif
+
+class EspSigKLock
+{
+  public:
+    EspSigKLock(EspSigKMutex &mutex) : mutex(mutex) { mutex.lock(); }
+    ~EspSigKLock() { mutex.unlock(); }
+
+  private:
+    EspSigKMutex &mutex;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "EspSigKRecorder.h"
+
+#if ESPSIGK_RECORDER
+
+#include <time.h>
+
+#include "EspSigKLog.h"
+
+EspSigKRecorder::EspSigKRecorder(EspSigKPathTable &paths) : paths(paths)
+{
+  source = "";
+  started = false;
+  bufferUsed = 0;
+  unsynced = false;
+  lastFlushMillis = 0;
+  firstSegment = 1;
+  currentSegment = 0;
+  segmentBytes = 0;
+  lastDeltaMillis = 0;
+  droppedBytes = 0;
+}
+
+bool EspSigKRecorder::begin(const char * source) {
+  this->source = source;
+
+  if (!LittleFS.begin()) {
+    SIGK_ERROR("Recorder: could not mount LittleFS");
+    return false;
+  }
+  LittleFS.mkdir(RECORDER_DIR);
+
+  // continue numbering after the segments already on flash
+  bool found = false;
+  File dir = LittleFS.open(RECORDER_DIR, "r");
+  File file;
+  while (dir && (file = dir.openNextFile())) {
+    const char * name = strrchr(file.name(), '/');
+    name = name ? name + 1 : file.name();
+    char * end;
+    uint32_t segment = strtoul(name, &end, 10);
+    file.close();
+    if (end == name || strcmp(end, ".rec") != 0) continue;
+
+    if (!found || segment < firstSegment) firstSegment = segment;
+    if (!found || segment > currentSegment) currentSegment = segment;
+    found = true;
+  }
+
+  started = true;
+  startSegment();
+  SIGK_INFO("Recorder: segments %u to %u", (unsigned int)firstSegment, (unsigned int)currentSegment);
+  return true;
+}
+
+void EspSigKRecorder::segmentFileName(uint32_t segment, char * name, size_t size) {
+  snprintf(name, size, RECORDER_DIR "/%08u.rec", (unsigned int)segment);
+}
+
+void EspSigKRecorder::record(const deltaValue * values, const char * valuePaths, size_t pathStride, uint8_t count) {
+  if (!started || count == 0) return;
+
+  // a delta and all its path definitions go in the same segment
+  if (segmentBytes + bufferUsed + recordDeltaWithPathsMaxSize(count, pathStride) > RECORDER_SEGMENT_SIZE) {
+    startSegment();
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t handle = values[i].pathHandle;
+    if (handle == PATH_HANDLE_NONE || pathsDefined[handle / 8] & (1 << (handle % 8))) continue;
+
+    const char * path = paths.get(handle);
+    size_t length = strlen(path);
+    putByte(RECORD_PATH);
+    putVarint(handle);
+    putVarint(length);
+    putBytes(path, length);
+    pathsDefined[handle / 8] |= (1 << (handle % 8));
+  }
+
+  uint32_t now = millis();
+  putByte(RECORD_DELTA);
+  putVarint(now - lastDeltaMillis);
+  putVarint(count);
+  for (uint8_t i = 0; i < count; i++) {
+    switch (values[i].type) {
+      case DELTA_VALUE_INT:    putByte(RECORD_VALUE_INT); break;
+      case DELTA_VALUE_DOUBLE: putByte(RECORD_VALUE_DOUBLE); break;
+      case DELTA_VALUE_BOOL:   putByte(values[i].b ? RECORD_VALUE_TRUE : RECORD_VALUE_FALSE); break;
+    }
+    putVarint(values[i].pathHandle);
+    if (values[i].pathHandle == PATH_HANDLE_NONE) {
+      const char * path = valuePaths + i * pathStride;
+      size_t length = strlen(path);
+      putVarint(length);
+      putBytes(path, length);
+    }
+    switch (values[i].type) {
+      case DELTA_VALUE_INT:
+        putVarint(((uint32_t)values[i].i << 1) ^ (uint32_t)(values[i].i >> 31)); // zigzag
+        break;
+      case DELTA_VALUE_DOUBLE:
+        putBytes(&values[i].d, sizeof(double));
+        break;
+      case DELTA_VALUE_BOOL:
+        break;
+    }
+  }
+  lastDeltaMillis = now;
+}
+
+void EspSigKRecorder::handle() {
+  if ((bufferUsed > 0 || unsynced) && (millis() - lastFlushMillis) >= RECORDER_FLUSH_INTERVAL) {
+    flush();
+  }
+}
+
+void EspSigKRecorder::flush() {
+  lastFlushMillis = millis();
+  if (!started) return;
+
+  writeBuffer();
+  if (unsynced && file) {
+    file.flush();
+  }
+  unsynced = false;
+}
+
+// Appends the buffer to the segment file without syncing it
+void EspSigKRecorder::writeBuffer() {
+  if (bufferUsed == 0) return;
+
+  char name[RECORDER_FILENAME_LENGTH];
+  segmentFileName(currentSegment, name, sizeof(name));
+  if (!file) {
+    file = LittleFS.open(name, "a");
+  }
+  size_t written = 0;
+  if (file) {
+    written = file.write(buffer, bufferUsed);
+  }
+  if (written != bufferUsed) {
+    SIGK_WARN("Recorder: write to %s failed", name);
+    droppedBytes += bufferUsed - written;
+    file.close(); // reopened for the next block
+  }
+  segmentBytes += written;
+  unsynced = unsynced || written > 0;
+  bufferUsed = 0;
+}
+
+void EspSigKRecorder::startSegment() {
+  char name[RECORDER_FILENAME_LENGTH];
+
+  flush();
+  if (file) {
+    file.close();
+  }
+  currentSegment++;
+  while (firstSegment + RECORDER_SEGMENTS <= currentSegment) {
+    segmentFileName(firstSegment, name, sizeof(name));
+    LittleFS.remove(name);
+    firstSegment++;
+  }
+
+  segmentBytes = 0;
+  memset(pathsDefined, 0, sizeof(pathsDefined));
+
+  time_t unixTime = time(NULL);
+  size_t sourceLength = strlen(source);     // cut to the config's maxHostnameLength by EspSigK
+  lastDeltaMillis = millis();
+  putBytes(RECORDER_MAGIC, 4);
+  putUint32(lastDeltaMillis);
+  putUint32(unixTime > 1600000000 ? (uint32_t)unixTime : 0); // 0 until the clock was set (SNTP)
+  putVarint(sourceLength);
+  putBytes(source, sourceLength);
+}
+
+// A full buffer goes to the file, so a record may be larger than the buffer
+void EspSigKRecorder::putByte(uint8_t b) {
+  if (bufferUsed == sizeof(buffer)) {
+    writeBuffer();
+  }
+  buffer[bufferUsed++] = b;
+}
+
+void EspSigKRecorder::putBytes(const void * data, size_t length) {
+  const uint8_t * bytes = (const uint8_t *)data;
+  while (length > 0) {
+    if (bufferUsed == sizeof(buffer)) {
+      writeBuffer();
+    }
+    size_t n = min(length, sizeof(buffer) - bufferUsed);
+    memcpy(buffer + bufferUsed, bytes, n);
+    bufferUsed += n;
+    bytes += n;
+    length -= n;
+  }
+}
+
+void EspSigKRecorder::putVarint(uint32_t v) {
+  while (v >= 0x80) {
+    putByte((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  putByte((uint8_t)v);
+}
+
+void EspSigKRecorder::putUint32(uint32_t v) {
+  for (uint8_t i = 0; i < 4; i++) {
+    putByte((uint8_t)(v >> (8 * i)));
+  }
+}
+
+#endif
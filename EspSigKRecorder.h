@@ -0,0 +1,99 @@
+#ifndef EspSigKRecorder_H
+#define EspSigKRecorder_H
+
+#include "EspSigKConfig.h"
+
+#if ESPSIGK_RECORDER
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include "EspSigKPaths.h"
+
+/*
+ * Black box log of the deltas the node sent, kept on LittleFS whether or not
+ * the server was reachable. Records are collected in RAM and appended in
+ * RECORDER_BUFFER_SIZE blocks to the segment file, which stays open. LittleFS
+ * copies the partly filled last block of a file to a new block whenever a file is
+ * synced (closed) and appended to again, so the file is only synced every
+ * RECORDER_FLUSH_INTERVAL (or when the segment is read or ends), not per block.
+ * A new segment file is started at every boot and every RECORDER_SEGMENT_SIZE
+ * bytes, only the last RECORDER_SEGMENTS are kept.
+ *
+ * Segment file RECORDER_DIR/NNNNNNNN.rec, little endian:
+ *   "SKR1", u32 millis() at start, u32 unix time at start (0 if unknown), varint length + source
+ *   RECORD_PATH   varint handle, varint length + path. Written before a handle's first use in the segment.
+ *   RECORD_DELTA  varint ms since previous delta (or segment start), varint value count, then per value
+ *                 type byte, varint handle, value (int: zigzag varint, double: 8 bytes, bool: in the type).
+ *                 Handle PATH_HANDLE_NONE (path table full) is followed by varint length + path.
+ *
+ * extras/sigkrec decodes segments back into deltas and replays them.
+ */
+
+#define RECORDER_DIR "/sigk"
+#define RECORDER_MAGIC "SKR1"
+#define RECORDER_FILENAME_LENGTH 24
+
+#define RECORD_PATH 0x01
+#define RECORD_DELTA 0x02
+#define RECORD_VALUE_INT 0x10
+#define RECORD_VALUE_DOUBLE 0x11
+#define RECORD_VALUE_FALSE 0x12
+#define RECORD_VALUE_TRUE 0x13
+
+// largest records: a path definition, and a delta of doubles with their paths inline
+constexpr size_t recordPathMaxSize(size_t pathLength) { return 1 + 2 + 2 + pathLength; }
+constexpr size_t recordDeltaMaxSize(size_t values, size_t pathLength) { return 1 + 5 + 2 + values * (1 + 2 + 2 + pathLength + 8); }
+// a delta with all its path definitions, checked against RECORDER_SEGMENT_SIZE by BasicEspSigK
+constexpr size_t recordDeltaWithPathsMaxSize(size_t values, size_t pathLength) {
+  return recordDeltaMaxSize(values, pathLength) + values * recordPathMaxSize(pathLength);
+}
+
+static_assert(RECORDER_SEGMENT_SIZE >= 4 * RECORDER_BUFFER_SIZE, "RECORDER_SEGMENT_SIZE too small");
+
+class EspSigKRecorder
+{
+  public:
+    EspSigKRecorder(EspSigKPathTable &paths);
+    bool begin(const char * source);
+    // pathStride bytes apart, valuePaths holds each value's path
+    void record(const deltaValue * values, const char * valuePaths, size_t pathStride, uint8_t count);
+    void handle();
+    void flush();           // buffer to the file and the file to flash
+
+    bool isStarted() { return started; }
+    uint32_t getFirstSegment() { return firstSegment; }
+    uint32_t getCurrentSegment() { return currentSegment; }
+    uint32_t getDroppedBytes() { return droppedBytes; }
+    void segmentFileName(uint32_t segment, char * name, size_t size);
+
+  private:
+    void startSegment();
+    void writeBuffer();
+    void putByte(uint8_t b);
+    void putBytes(const void * data, size_t length);
+    void putVarint(uint32_t v);
+    void putUint32(uint32_t v);
+
+    EspSigKPathTable &paths;
+    const char * source;
+    bool started;
+
+    uint8_t buffer[RECORDER_BUFFER_SIZE];
+    size_t bufferUsed;
+    File file;              // current segment, open for appending
+    bool unsynced;          // written to the file since the last flush()
+    uint32_t lastFlushMillis;
+
+    uint32_t firstSegment;
+    uint32_t currentSegment;
+    uint32_t segmentBytes;
+    uint32_t lastDeltaMillis;
+    uint8_t pathsDefined[PATH_HANDLE_NONE / 8 + 1];   // handles with a RECORD_PATH in this segment
+
+    uint32_t droppedBytes;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#include "EspSigKStream.h"
+
+EspSigKStream::EspSigKStream(EspSigKTransport &transport, EspSigKFrameQueue &frameQueue, signalKStats &stats)
+  : transport(transport), frameQueue(frameQueue), stats(stats)
+{
+  frame = "";
+  connected = false;
+  reconnectInterval = 10000;
+  timerReconnect = millis();
+  disconnectedAt = 0;
+#if ESPSIGK_LATENCY
+  latency = NULL;
+#endif
+}
+
+size_t EspSigKStream::queueDelta(const char * source, const deltaValue * values, const char * valuePaths, size_t pathStride,
+                                 uint8_t count, uint32_t capturedMicros) {
+  char * slot = frameQueue.reserve();
+  if (slot == NULL) return 0;     // counted by the queue
+
+  size_t length = serializeDelta(source, values, valuePaths, pathStride, count, slot, frameQueue.getFrameSize());
+  if (length == 0) {
+    stats.deltasOversize++;
+    return 0;
+  }
+  frame = slot;
+
+  frameInfo info = { length, 0, 0 };
+#if ESPSIGK_LATENCY
+  info.capturedMicros = capturedMicros;
+  info.serializedMicros = micros();
+  if (latency != NULL && capturedMicros != 0) latency->captureToSerialize.add(info.serializedMicros - capturedMicros);
+#else
+  (void)capturedMicros;
+#endif
+  frameQueue.commit(info);
+  return length;
+}
+
+bool EspSigKStream::connect() {
+  if (connected) return true;
+  connected = transport.connect();
+  if (!connected) return false;
+
+  stats.connects++;
+  if (stats.disconnects > 0) {
+    stats.lastReconnectTime = millis() - disconnectedAt;
+  }
+  transport.connected();
+  return true;
+}
+
+void EspSigKStream::handle() {
+  // the timer runs while connected too, so a lost connection comes back anywhere
+  // from right away to reconnectInterval later
+  uint32_t now = millis();
+  if (now - timerReconnect >= reconnectInterval) {
+    timerReconnect = now;
+    connect();
+  }
+
+  if (connected) {
+    if (transport.available()) {
+      transport.poll();
+    } else {
+      closed();
+    }
+  }
+  sendQueuedFrames();
+}
+
+void EspSigKStream::sendQueuedFrames() {
+  const char * queued;
+  frameInfo info;
+
+  while ((queued = frameQueue.peek(info)) != NULL) {
+    if (!connected) {
+      stats.deltasNotConnected++;
+    } else if (transport.send(queued, info.length)) {
+      stats.deltasSent++;
+      stats.bytesSent += info.length;
+#if ESPSIGK_LATENCY
+      if (latency != NULL) {
+        uint32_t sentMicros = micros();
+        latency->serializeToSend.add(sentMicros - info.serializedMicros);
+        if (info.capturedMicros != 0) latency->captureToSend.add(sentMicros - info.capturedMicros);
+      }
+#endif
+    } else {
+      stats.sendErrors++;
+      if (!transport.available()) closed();
+    }
+    frameQueue.release();
+  }
+}
+
+// Connection lost, the reconnect timer in handle() brings it back
+void EspSigKStream::closed() {
+  if (!connected) return;
+  connected = false;
+  transport.close();
+  disconnectedAt = millis();
+  stats.disconnects++;
+  transport.lost();
+}
@@ -0,0 +1,89 @@
+#ifndef EspSigKStream_H
+#define EspSigKStream_H
+
+#include <Arduino.h>
+
+#include "EspSigKConfig.h"
+#include "EspSigKDelta.h"
+#include "EspSigKFrameQueue.h"
+#include "EspSigKLatency.h"
+
+// Counters since boot, for checking throughput and reconnects from outside (also at /signalk/stats)
+struct signalKStats {
+  uint32_t deltasSent;          // handed to the websocket
+  uint32_t deltasNotConnected;  // discarded, no websocket connection
+  uint32_t deltasDropped;       // discarded, frame queue full
+  uint32_t deltasOversize;      // discarded, serialized delta larger than the frame size
+  uint32_t valuesPathRejected;  // values discarded, path longer than the config's maxDeltaPathLength
+  uint32_t valuesNotCached;     // values sent, but no room in the path table: not in the REST API, recorded with their path
+  uint32_t bytesSent;
+  uint32_t sendErrors;
+  uint32_t connects;
+  uint32_t disconnects;
+  uint32_t lastReconnectTime;   // ms from losing the websocket connection to having it back
+};
+
+// The connection deltas are streamed over, the websocket client on the ESP
+class EspSigKTransport
+{
+  public:
+    virtual bool connect() = 0;                                 // open it, called by the reconnect timer
+    virtual bool available() = 0;                               // still open
+    virtual void poll() = 0;                                    // read what the server sent
+    virtual bool send(const char * frame, size_t length) = 0;
+    virtual void close() = 0;                                   // release it, also once the server closed it
+    virtual void connected() {}                                 // after connect() succeeded and was counted
+    virtual void lost() {}                                      // after the connection was lost and counted
+
+  protected:
+    ~EspSigKTransport() {}
+};
+
+/*
+ * Deltas from the sketch to the server. The producer (sendDelta()) serializes
+ * each delta into the frame queue with queueDelta(), the network side calls
+ * handle(): every reconnect interval it reconnects a lost connection, it polls
+ * the connection and sends the queued frames. Any of these ends the connection:
+ * the transport closing it (close frame, socket closed), available() going false
+ * before a poll, a send failing on a connection no longer available.
+ *
+ * Only uses the transport, the frame queue and the serializer, extras/sigkload
+ * runs it on the host over its own websocket client.
+ */
+class EspSigKStream
+{
+  public:
+    EspSigKStream(EspSigKTransport &transport, EspSigKFrameQueue &frameQueue, signalKStats &stats);
+
+    // producer: the frame's length, 0 when dropped (queue full or larger than a frame).
+    // The frame stays at lastFrame() until the next queueDelta().
+    size_t queueDelta(const char * source, const deltaValue * values, const char * valuePaths, size_t pathStride,
+                      uint8_t count, uint32_t capturedMicros);
+    const char * lastFrame() { return frame; }
+
+    // network side
+    bool connect();
+    void handle();
+    void sendQueuedFrames();
+    void closed();
+    bool isConnected() { return connected; }
+    void setReconnectInterval(uint32_t ms) { reconnectInterval = ms; }
+#if ESPSIGK_LATENCY
+    void setLatency(EspSigKLatency * latency) { this->latency = latency; }
+#endif
+
+  private:
+    EspSigKTransport &transport;
+    EspSigKFrameQueue &frameQueue;
+    signalKStats &stats;
+    const char * frame;
+    bool connected;
+    uint32_t reconnectInterval;
+    uint32_t timerReconnect;
+    uint32_t disconnectedAt;
+#if ESPSIGK_LATENCY
+    EspSigKLatency * latency;
+#endif
+};
+
+#endif
@@ -25,6 +25,9 @@ void setup() {
                                         // add a user via the admin console, and then run the "signalk-generate-token" script
                                         // included with signalk to generate the string. (or disable security)
 
+  sigK.setMeta("some.signalk.path", F("m/s"), F("Some speed")); // Optional. Units and name shown by the server,
+                                        // sent once per connection instead of with every delta
+
   sigK.begin();                         // Start everything. Connect to wifi, setup services, etc...
 
 }
@@ -0,0 +1,124 @@
+/*
+ * Host stress test of EspSigKFrameQueue: a producer and a consumer thread hand
+ * frames over like sendDelta() and the ESP32 network task do. Checks that every
+ * frame arrives once, in order and intact, and that frames dropped on a full
+ * queue are exactly the ones counted.
+ *
+ * Build: g++ -std=c++11 -O2 -pthread -I host -I .. -o framequeue_test framequeue_test.cpp
+ * Usage: framequeue_test [frames]     (exit status 0 when all checks pass)
+ */
+
+#include <thread>
+
+#ifndef FRAME_QUEUE_DEPTH
+#define FRAME_QUEUE_DEPTH 4     // as with the ESP32 network task
+#endif
+#include "EspSigKFrameQueue.h"
+
+// only here for EspSigKConfig.h's Arduino.h, the queue doesn't use them
+unsigned long millis() { return 0; }
+unsigned long micros() { return 0; }
+void delay(unsigned long) {}
+
+static int fillFrame(char * frame, uint32_t sequence) {
+  // varying lengths, up to the whole slot
+  int length = snprintf(frame, DELTA_FRAME_SIZE, "{\"sequence\":%u,\"fill\":\"", (unsigned int)sequence);
+  int fill = sequence % (DELTA_FRAME_SIZE - length - 2);
+  memset(frame + length, 'a' + sequence % 26, fill);
+  length += fill;
+  frame[length++] = '"';
+  frame[length++] = '}';
+  return length;
+}
+
+// Every frame is retried until the queue takes it, nothing may be lost
+static bool runLossless(uint32_t frames) {
+  EspSigKStaticFrameQueue<> queue;
+  std::thread producer([&]() {
+    for (uint32_t sequence = 0; sequence < frames; sequence++) {
+      char * frame;
+      while ((frame = queue.reserve()) == NULL) std::this_thread::yield();
+      frameInfo info = { (size_t)fillFrame(frame, sequence), sequence, ~sequence };
+      queue.commit(info);
+    }
+  });
+
+  char expected[DELTA_FRAME_SIZE];
+  uint32_t received = 0;
+  uint32_t corrupted = 0;
+  while (received < frames) {
+    frameInfo info;
+    const char * frame = queue.peek(info);
+    if (frame == NULL) {
+      std::this_thread::yield();
+      continue;
+    }
+    size_t length = fillFrame(expected, received);
+    if (info.length != length || memcmp(frame, expected, length) != 0 ||
+        info.capturedMicros != received || info.serializedMicros != ~received) {
+      corrupted++;
+    }
+    queue.release();
+    received++;
+  }
+  producer.join();
+
+  printf("lossless: %u frames, %u corrupted or out of order, %u full queue retries\n",
+         (unsigned int)received, (unsigned int)corrupted, (unsigned int)queue.getDropped());
+  return corrupted == 0;
+}
+
+// Like sendDelta(): a frame that finds the queue full is dropped and counted
+static bool runDropping(uint32_t frames) {
+  EspSigKStaticFrameQueue<> queue;
+  std::atomic<bool> done(false);
+  std::thread producer([&]() {
+    for (uint32_t sequence = 0; sequence < frames; sequence++) {
+      char * frame = queue.reserve();
+      if (frame != NULL) {
+        frameInfo info = { (size_t)fillFrame(frame, sequence), sequence, 0 };
+        queue.commit(info);
+      }
+      if (sequence % 16 < 8) std::this_thread::yield(); // then a burst of 8 against a depth of 4
+    }
+    done = true;
+  });
+
+  char expected[DELTA_FRAME_SIZE];
+  uint32_t received = 0;
+  uint32_t corrupted = 0;
+  int64_t last = -1;
+  while (true) {
+    frameInfo info;
+    bool finished = done;
+    const char * frame = queue.peek(info);
+    if (frame == NULL) {
+      if (finished) break;
+      std::this_thread::yield();
+      continue;
+    }
+    size_t length = fillFrame(expected, info.capturedMicros);
+    if ((int64_t)info.capturedMicros <= last || info.length != length || memcmp(frame, expected, length) != 0) {
+      corrupted++;
+    }
+    last = info.capturedMicros;
+    queue.release();
+    received++;
+  }
+  producer.join();
+
+  uint32_t dropped = queue.getDropped();
+  printf("dropping: %u frames, %u received, %u dropped, %u corrupted or out of order\n",
+         (unsigned int)frames, (unsigned int)received, (unsigned int)dropped, (unsigned int)corrupted);
+  return corrupted == 0 && received + dropped == frames;
+}
+
+int main(int argc, char ** argv) {
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+  printf("FRAME_QUEUE_DEPTH %u, DELTA_FRAME_SIZE %u\n", (unsigned int)FRAME_QUEUE_DEPTH, (unsigned int)DELTA_FRAME_SIZE);
+
+  bool ok = runLossless(frames);
+  ok = runDropping(frames) && ok;
+  printf(ok ? "all checks passed\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+/*
+ * Just enough of Arduino.h to build parts of the library on a Linux/macOS host,
+ * for the tests and tools in extras. The program defines millis(), micros() and
+ * delay(), so a test can run them on a simulated clock.
+ */
+#ifndef EspSigKHostArduino_H
+#define EspSigKHostArduino_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+#endif
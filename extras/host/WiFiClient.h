@@ -0,0 +1,82 @@
+/*
+ * WiFiClient for host builds, a blocking TCP client on POSIX sockets with the
+ * calls the library uses. The methods are virtual so a test can script a server.
+ */
+#ifndef EspSigKHostWiFiClient_H
+#define EspSigKHostWiFiClient_H
+
+#include <Arduino.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class WiFiClient
+{
+  public:
+    WiFiClient() : fd(-1), timeout(1000) {}
+    virtual ~WiFiClient() { stop(); }
+
+    virtual int connect(const char * host, uint16_t port) {
+      char service[8];
+      struct addrinfo hints, * result;
+      stop();
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
+      snprintf(service, sizeof(service), "%u", port);
+      if (getaddrinfo(host, service, &hints, &result) != 0) return 0;
+      fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+      if (fd >= 0 && ::connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+        ::close(fd);
+        fd = -1;
+      }
+      freeaddrinfo(result);
+      if (fd < 0) return 0;
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return 1;
+    }
+    virtual size_t write(const uint8_t * data, size_t length) {
+      size_t written = 0;
+      while (fd >= 0 && written < length) {
+        ssize_t n = send(fd, data + written, length - written, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        written += n;
+      }
+      return written;
+    }
+    virtual int available() {
+      int n = 0;
+      if (fd < 0 || ioctl(fd, FIONREAD, &n) != 0) return 0;
+      return n;
+    }
+    virtual int read() {
+      uint8_t c;
+      if (fd < 0 || recv(fd, &c, 1, MSG_DONTWAIT) != 1) return -1;
+      return c;
+    }
+    // false once the peer closed and everything it sent was read
+    virtual uint8_t connected() {
+      uint8_t c;
+      if (fd < 0) return 0;
+      ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+      return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+    virtual void stop() {
+      if (fd >= 0) ::close(fd);
+      fd = -1;
+    }
+    void setTimeout(unsigned long ms) { timeout = ms; }
+
+  protected:
+    int fd;
+    unsigned long timeout;
+};
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * Host test of EspSigKHttpClient against a scripted WiFiClient: keep-alive reuse
+ * and retry, Connection: close, HTTP/1.0, chunked bodies and timeouts. Time only
+ * moves in delay(), so the timeouts run instantly.
+ *
+ * Build: g++ -std=c++11 -O2 -I host -I .. -o httpclient_test httpclient_test.cpp ../EspSigKHttpClient.cpp
+ * Usage: httpclient_test     (exit status 0 when all checks pass)
+ */
+
+#include <string>
+#include <vector>
+
+#include "EspSigKHttpClient.h"
+
+static unsigned long fakeMillis = 0;
+unsigned long millis() { return fakeMillis; }
+unsigned long micros() { return fakeMillis * 1000; }
+void delay(unsigned long ms) { fakeMillis += ms; }
+
+// in place of a reply: the server closes instead of answering, never answers, or the write fails
+#define REPLY_DROP "\x01" "drop"
+#define REPLY_HANG "\x01" "hang"
+#define REPLY_WRITE_FAIL "\x01" "writefail"
+
+struct ScriptedConnection {
+  std::vector<std::string> replies;   // one per request, released when the request head is written
+  bool closeAfterLast;                // server closes once the last reply is sent
+};
+
+class ScriptedClient : public WiFiClient
+{
+  public:
+    std::vector<ScriptedConnection> script;   // one per connect(), connect() fails when empty
+    std::string requests;                     // everything written
+    int connects = 0;
+
+    int connect(const char *, uint16_t) override {
+      stop();
+      if (script.empty()) return 0;
+      current = script.front();
+      script.erase(script.begin());
+      open = true;
+      closed = false;
+      data.clear();
+      pos = 0;
+      connects++;
+      return 1;
+    }
+    size_t write(const uint8_t * buffer, size_t length) override {
+      if (!open || closed) return 0;
+      std::string text((const char *)buffer, length);
+      if (text.find("\r\n\r\n") != std::string::npos) {
+        if (current.replies.empty()) {
+          closed = true;
+        } else {
+          std::string reply = current.replies.front();
+          current.replies.erase(current.replies.begin());
+          if (reply == REPLY_WRITE_FAIL) {
+            closed = true;
+            return 0;
+          }
+          if (reply == REPLY_DROP) {
+            closed = true;
+          } else if (reply != REPLY_HANG) {
+            data += reply;
+            if (current.replies.empty() && current.closeAfterLast) closed = true;
+          }
+        }
+      }
+      requests += text;
+      return length;
+    }
+    int available() override { return open ? (int)(data.size() - pos) : 0; }
+    int read() override { return available() > 0 ? (uint8_t)data[pos++] : -1; }
+    uint8_t connected() override { return open && (pos < data.size() || !closed); }
+    void stop() override { open = false; }
+
+  private:
+    ScriptedConnection current;
+    bool open = false;
+    bool closed = false;
+    std::string data;
+    size_t pos = 0;
+};
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } \
+  } while (0)
+
+struct Result {
+  int status;
+  std::string body;
+};
+
+static Result get(EspSigKHttpClient &http, const char * path = "/signalk/v1/requests/1") {
+  char body[64];
+  int32_t length = 0;
+  Result result;
+  result.status = http.request("server", 3000, "GET", path, "", body, sizeof(body), length);
+  if (result.status > 0) result.body.assign(body, length);
+  return result;
+}
+
+static void testKeepAliveReuse() {
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { "HTTP/1.1 202 Accepted\r\nContent-Length: 7\r\n\r\nPENDING",
+                              "HTTP/1.1 200 OK\r\ncontent-length: 8\r\n\r\nAPPROVED" }, false });
+
+  Result first = get(http);
+  CHECK(first.status == 202 && first.body == "PENDING");
+  CHECK(http.isKeptAlive());
+  Result second = get(http);
+  CHECK(second.status == 200 && second.body == "APPROVED");
+  CHECK(client.connects == 1);
+  CHECK(client.requests.find("GET /signalk/v1/requests/1 HTTP/1.1\r\nHost: server:3000\r\nConnection: keep-alive\r\n\r\n") == 0);
+}
+
+static void testRetryOnStaleConnection() {
+  // the server closed the idle connection, we only notice after sending
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\na", REPLY_DROP }, false });
+  client.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\nb" }, false });
+  CHECK(get(http).body == "a");
+  Result retried = get(http);
+  CHECK(retried.status == 200 && retried.body == "b");
+  CHECK(client.connects == 2);
+
+  // same, with the write failing
+  ScriptedClient client2;
+  EspSigKHttpClient http2(&client2);
+  client2.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\na", REPLY_WRITE_FAIL }, false });
+  client2.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\nb" }, false });
+  CHECK(get(http2).body == "a");
+  CHECK(get(http2).body == "b");
+  CHECK(client2.connects == 2);
+
+  // a fresh connection is not retried
+  ScriptedClient client3;
+  EspSigKHttpClient http3(&client3);
+  client3.script.push_back({ { REPLY_DROP }, false });
+  client3.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\nb" }, false });
+  CHECK(get(http3).status == HTTP_ERROR_RESPONSE);
+  CHECK(client3.connects == 1);
+}
+
+static void testConnectionClose() {
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok" }, true });
+  client.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok" }, false });
+  Result result = get(http);
+  CHECK(result.status == 200 && result.body == "ok");
+  CHECK(!http.isKeptAlive());
+  CHECK(get(http).status == 200);
+  CHECK(client.connects == 2);
+}
+
+static void testHttp10() {
+  // closes by default, the body ends with the connection
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n{\"state\":\"PENDING\"}" }, true });
+  Result result = get(http);
+  CHECK(result.status == 200 && result.body == "{\"state\":\"PENDING\"}");
+  CHECK(!http.isKeptAlive());
+
+  // unless it says keep-alive
+  ScriptedClient client2;
+  EspSigKHttpClient http2(&client2);
+  client2.script.push_back({ { "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 2\r\n\r\nok",
+                               "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 2\r\n\r\nok" }, false });
+  CHECK(get(http2).status == 200);
+  CHECK(http2.isKeptAlive());
+  CHECK(get(http2).status == 200);
+  CHECK(client2.connects == 1);
+
+  // keep-alive without a length can't be reused
+  ScriptedClient client3;
+  EspSigKHttpClient http3(&client3);
+  client3.script.push_back({ { "HTTP/1.1 200 OK\r\n\r\nuntil close" }, true });
+  CHECK(get(http3).body == "until close");
+  CHECK(!http3.isKeptAlive());
+}
+
+static void testChunked() {
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                              "4\r\nWiki\r\n5;name=value\r\npedia\r\nB\r\n in\r\nchunks\r\n0\r\nExpires: never\r\n\r\n",
+                              "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n" }, false });
+  Result result = get(http);
+  CHECK(result.status == 200 && result.body == "Wikipedia in\r\nchunks");
+  CHECK(http.isKeptAlive());
+  // the trailers were consumed, the connection is in sync for the next response
+  Result empty = get(http);
+  CHECK(empty.status == 200 && empty.body == "");
+  CHECK(client.connects == 1);
+}
+
+static void testTimeouts() {
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { REPLY_HANG }, false });
+  unsigned long start = millis();
+  CHECK(get(http).status == HTTP_ERROR_RESPONSE);
+  CHECK(millis() - start >= HTTP_RESPONSE_TIMEOUT);
+  CHECK(millis() - start < HTTP_RESPONSE_TIMEOUT + 100);
+  CHECK(!http.isKeptAlive());
+
+  // body shorter than its Content-Length
+  ScriptedClient client2;
+  EspSigKHttpClient http2(&client2);
+  client2.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc" }, false });
+  CHECK(get(http2).status == HTTP_ERROR_BODY);
+
+  // chunk that never ends
+  ScriptedClient client3;
+  EspSigKHttpClient http3(&client3);
+  client3.script.push_back({ { "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n10\r\nabc" }, false });
+  CHECK(get(http3).status == HTTP_ERROR_BODY);
+}
+
+static void testErrors() {
+  ScriptedClient refused;
+  EspSigKHttpClient http(&refused);
+  CHECK(get(http).status == HTTP_ERROR_CONNECT);
+
+  ScriptedClient client;
+  EspSigKHttpClient http2(&client);
+  client.script.push_back({ { "SSH-2.0-OpenSSH\r\n\r\n" }, false });
+  CHECK(get(http2).status == HTTP_ERROR_RESPONSE);
+
+  // larger than the body buffer
+  ScriptedClient client3;
+  EspSigKHttpClient http3(&client3);
+  client3.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n" + std::string(100, 'x') }, false });
+  CHECK(get(http3).status == HTTP_ERROR_BODY_TOO_LARGE);
+
+  // request larger than HTTP_REQUEST_BUFFER_SIZE
+  ScriptedClient client4;
+  EspSigKHttpClient http4(&client4);
+  client4.script.push_back({ { "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n" }, false });
+  std::string longPath = "/" + std::string(HTTP_REQUEST_BUFFER_SIZE, 'p');
+  CHECK(get(http4, longPath.c_str()).status == HTTP_ERROR_REQUEST_TOO_LONG);
+}
+
+static void testPost() {
+  ScriptedClient client;
+  EspSigKHttpClient http(&client);
+  client.script.push_back({ { "HTTP/1.1 202 Accepted\r\nContent-Length: 2\r\n\r\n{}" }, false });
+  char body[16];
+  int32_t length;
+  const char * payload = "{\"clientId\":\"1234\",\"description\":\"esp\"}";
+  CHECK(http.request("server", 3000, "POST", "/signalk/v1/access/requests", payload, body, sizeof(body), length) == 202);
+  CHECK(client.requests.find("POST /signalk/v1/access/requests HTTP/1.1\r\n") == 0);
+  CHECK(client.requests.find("Content-Length: 39\r\n\r\n{\"clientId\"") != std::string::npos);
+}
+
+int main() {
+  testKeepAliveReuse();
+  testRetryOnStaleConnection();
+  testConnectionClose();
+  testHttp10();
+  testChunked();
+  testTimeouts();
+  testErrors();
+  testPost();
+
+  if (failures > 0) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,383 @@
+/*
+ * Load driver for extras/sigkstub, loopback only. Gets a token through the access
+ * request flow with the library's EspSigKHttpClient, then streams deltas at increasing
+ * rates the way the ESP32 build does, through the library's own EspSigKStream: the
+ * sketch side serializes each delta into the EspSigKFrameQueue with queueDelta() (the
+ * serializer sendDelta() uses) and drops it when the queue is full, a network thread
+ * runs the stream's handle(), which sends the frames and reconnects after the reconnect
+ * interval when the connection is lost. For each rate it prints the sustained throughput,
+ * the drop rate, p50/p99 sample-to-server latency and how long reconnects took, from the
+ * stub's /stats, and the library's own capture-to-send p99.
+ *
+ * EspSigK itself needs ArduinoWebsockets and the ESP WiFi/WebServer, so the transport
+ * under the stream is a minimal websocket client (or UDP) here.
+ *
+ * Build, from extras (the queue depth and latency tracing must reach every file):
+ *   g++ -std=c++11 -O2 -pthread -DFRAME_QUEUE_DEPTH=4 -DESPSIGK_LATENCY=1 -I host -I .. -o sigkload/sigkload \
+ *       sigkload/sigkload.cpp ../EspSigKHttpClient.cpp ../EspSigKDelta.cpp ../EspSigKStream.cpp ../EspSigKLatency.cpp
+ * Usage: sigkload [-p port] [-r rate,rate,..] [-s seconds] [-i reconnectMs] [-U udpPort]
+ *
+ *   -p 3000                    sigkstub's HTTP and websocket port
+ *   -r 100,1000,5000,20000     deltas per second for each step
+ *   -s 5                       seconds per step
+ *   -i 1000                    reconnect interval, the library's default is 10000
+ *   -U 8375                    send the deltas over UDP instead of the websocket
+ *
+ * Run against "sigkstub -d 2000" to have the connection dropped every 2 s.
+ */
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#include "EspSigKHttpClient.h"
+#include "EspSigKStream.h"
+
+#if !ESPSIGK_LATENCY
+#error "build with -DESPSIGK_LATENCY=1 (and -DFRAME_QUEUE_DEPTH=4), see above"
+#endif
+
+static const char * HOST = "127.0.0.1";
+
+static uint64_t nowMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+unsigned long millis() { return (unsigned long)(nowMicros() / 1000); }
+unsigned long micros() { return (unsigned long)nowMicros(); }
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+// "key":"<string>" in a JSON body, empty if not there
+static std::string jsonString(const std::string &body, const char * key) {
+  std::string pattern = std::string("\"") + key + "\":\"";
+  size_t at = body.find(pattern);
+  if (at == std::string::npos) return "";
+  at += pattern.size();
+  return body.substr(at, body.find('"', at) - at);
+}
+// "key":<number> in a JSON body, 0 if not there
+static double jsonNumber(const std::string &body, const char * key) {
+  std::string pattern = std::string("\"") + key + "\":";
+  size_t at = body.find(pattern);
+  return at == std::string::npos ? 0 : strtod(body.c_str() + at + pattern.size(), NULL);
+}
+
+static int httpGet(EspSigKHttpClient &http, uint16_t port, const char * method, const char * path, const char * payload,
+                   std::string &body) {
+  char buffer[2048];
+  int32_t length = 0;
+  int status = http.request(HOST, port, method, path, payload, buffer, sizeof(buffer), length);
+  body.assign(buffer, status > 0 && length > 0 ? length : 0);
+  return status;
+}
+
+/* ******************************************************************** */
+/* Transports, just what sending deltas needs                           */
+/* ******************************************************************** */
+
+static uint32_t recoveryMax = 0;    // ms, loss detected to connected again
+
+class LoadTransport : public EspSigKTransport
+{
+  public:
+    LoadTransport(signalKStats &stats) : stats(stats) {}
+    void connected() {
+      if (stats.disconnects > 0 && stats.lastReconnectTime > recoveryMax) recoveryMax = stats.lastReconnectTime;
+    }
+
+  private:
+    signalKStats &stats;
+};
+
+class LoadWebsocket : public LoadTransport
+{
+  public:
+    LoadWebsocket(signalKStats &stats, uint16_t port, const std::string &path) : LoadTransport(stats), port(port), path(path) {}
+
+    bool connect() {
+      close();
+      if (!client.connect(HOST, port)) return false;
+      char request[512];
+      int length = snprintf(request, sizeof(request),
+                            "GET %s HTTP/1.1\r\nHost: %s:%u\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+                            path.c_str(), HOST, port);
+      if (client.write((const uint8_t *)request, length) != (size_t)length) return false;
+
+      // the stub's Sec-WebSocket-Accept is checked by its own SHA-1, only the status matters here
+      std::string head;
+      uint32_t deadline = millis() + HTTP_RESPONSE_TIMEOUT;
+      while (head.find("\r\n\r\n") == std::string::npos) {
+        int c = client.read();
+        if (c >= 0) head += (char)c;
+        else if (!client.connected() || (int32_t)(millis() - deadline) > 0) return false;
+        else delay(1);
+      }
+      open = head.compare(0, 12, "HTTP/1.1 101") == 0;
+      return open;
+    }
+
+    bool available() {
+      return open && client.connected();
+    }
+
+    // Reads what the server sent (hello, pongs)
+    void poll() {
+      while (client.available() > 0) {
+        if (client.read() < 0) break;
+      }
+    }
+
+    bool send(const char * text, size_t length) {
+      uint8_t head[8];
+      size_t headLength = 2;
+      head[0] = 0x81;
+      if (length < 126) {
+        head[1] = 0x80 | length;
+      } else {
+        head[1] = 0x80 | 126;
+        head[2] = length >> 8;
+        head[3] = length & 0xFF;
+        headLength = 4;
+      }
+      uint32_t mask = (uint32_t)rand();
+      memcpy(head + headLength, &mask, 4);
+      headLength += 4;
+      frame.assign((const char *)head, headLength);
+      frame.append(text, length);
+      for (size_t i = 0; i < length; i++) frame[headLength + i] ^= head[headLength - 4 + i % 4];
+      return open && client.write((const uint8_t *)frame.data(), frame.size()) == frame.size();
+    }
+
+    void close() {
+      client.stop();
+      open = false;
+    }
+
+  private:
+    uint16_t port;
+    std::string path;
+    WiFiClient client;
+    std::string frame;
+    bool open = false;
+};
+
+// Signal K UDP input, one delta per datagram. Never lost, so never reconnected.
+class LoadUdp : public LoadTransport
+{
+  public:
+    LoadUdp(signalKStats &stats, uint16_t port) : LoadTransport(stats), udp(-1) {
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = htons(port);
+    }
+
+    bool connect() {
+      if (udp < 0) udp = socket(AF_INET, SOCK_DGRAM, 0);
+      return udp >= 0;
+    }
+    bool available() { return udp >= 0; }
+    void poll() {}
+    bool send(const char * text, size_t length) {
+      return sendto(udp, text, length, 0, (struct sockaddr *)&address, sizeof(address)) == (ssize_t)length;
+    }
+    void close() {
+      if (udp >= 0) ::close(udp);
+      udp = -1;
+    }
+
+  private:
+    int udp;
+    struct sockaddr_in address;
+};
+
+/* ******************************************************************** */
+/* Sketch side and network side                                         */
+/* ******************************************************************** */
+
+static EspSigKStaticFrameQueue<> frameQueue;
+static signalKStats stats;
+static EspSigKLatency latency;
+static EspSigKStream * stream;
+
+// like xTaskNotifyGive()/ulTaskNotifyTake() between sendDelta() and the network task
+static std::mutex notifyMutex;
+static std::condition_variable notifyCondition;
+static bool notified = false;
+
+static void notifyGive() {
+  std::lock_guard<std::mutex> lock(notifyMutex);
+  notified = true;
+  notifyCondition.notify_one();
+}
+static void notifyTake(unsigned int ms) {
+  std::unique_lock<std::mutex> lock(notifyMutex);
+  notifyCondition.wait_for(lock, std::chrono::milliseconds(ms), [] { return notified; });
+  notified = false;
+}
+
+static std::atomic<bool> running(true);
+
+static uint16_t port = 3000;
+static uint16_t udpPort = 0;
+static uint32_t reconnectInterval = 1000;
+
+// the network task: setupWebSocket()'s first connect, then networkHandle()'s part
+static void networkLoop() {
+  stream->connect();
+  while (running) {
+    stream->handle();
+    notifyTake(10);   // NETWORK_TASK_POLL_INTERVAL
+  }
+  stream->closed();
+}
+
+// addDeltaValue() x 3 and sendDelta(), with the capture time as an int like a sketch would send it
+static uint32_t committed = 0;
+
+static bool sendDelta(uint32_t sequence) {
+  static const char valuePaths[3][32] = { "test.sequence", "test.capturedMicros", "environment.outside.temperature" };
+  deltaValue values[3];
+  uint32_t capturedMicros = micros() | 1;
+
+  values[0].type = DELTA_VALUE_INT;
+  values[0].i = (int)sequence;
+  values[1].type = DELTA_VALUE_INT;
+  values[1].i = (int)(nowMicros() % 1000000000);    // sigkstub's CAPTURE_WRAP
+  values[2].type = DELTA_VALUE_DOUBLE;
+  values[2].d = 293.15 + (sequence % 100) / 10.0;
+  for (uint8_t i = 0; i < 3; i++) values[i].pathHandle = PATH_HANDLE_NONE;
+
+  size_t length = stream->queueDelta("sigkload", values, valuePaths[0], sizeof(valuePaths[0]), 3, capturedMicros);
+  if (length > 0) committed++;
+  notifyGive();
+  return length > 0;
+}
+
+/* ******************************************************************** */
+/* Steps                                                                */
+/* ******************************************************************** */
+
+static bool getToken(EspSigKHttpClient &http, std::string &token) {
+  std::string body;
+  int status = httpGet(http, port, "POST", "/signalk/v1/access/requests",
+                       "{\"clientId\":\"1c7b5c1e-0000-4000-8000-5167c10ad000\",\"description\":\"sigkload\"}", body);
+  std::string href = jsonString(body, "href");
+  if (status != 202 || href.empty()) {
+    fprintf(stderr, "sigkload: access request failed (%d) %s\n", status, body.c_str());
+    return false;
+  }
+  uint32_t start = millis();
+  while (true) {
+    status = httpGet(http, port, "GET", href.c_str(), "", body);
+    if (status != 200) {
+      fprintf(stderr, "sigkload: polling %s failed (%d)\n", href.c_str(), status);
+      return false;
+    }
+    std::string permission = jsonString(body, "permission");
+    if (permission == "APPROVED") {
+      token = jsonString(body, "token");
+      printf("access request approved after %u ms, token %s\n", (unsigned int)(millis() - start), token.c_str());
+      return true;
+    }
+    if (permission == "DENIED") {
+      fprintf(stderr, "sigkload: access request denied\n");
+      return false;
+    }
+    delay(200);
+  }
+}
+
+static void usage() {
+  fprintf(stderr, "usage: sigkload [-p port] [-r rate,rate,..] [-s seconds] [-i reconnectMs] [-U udpPort]\n");
+  exit(2);
+}
+
+int main(int argc, char ** argv) {
+  std::vector<uint32_t> rates;
+  uint32_t seconds = 5;
+  int option;
+  while ((option = getopt(argc, argv, "p:r:s:i:U:")) != -1) {
+    switch (option) {
+      case 'p': port = atoi(optarg); break;
+      case 'r':
+        for (char * rate = strtok(optarg, ","); rate != NULL; rate = strtok(NULL, ",")) rates.push_back(atoi(rate));
+        break;
+      case 's': seconds = atoi(optarg); break;
+      case 'i': reconnectInterval = atoi(optarg); break;
+      case 'U': udpPort = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (rates.empty()) rates = { 100, 1000, 5000, 20000 };
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  WiFiClient httpWiFiClient;
+  EspSigKHttpClient http(&httpWiFiClient);
+  std::string token, body;
+  if (!getToken(http, token)) return 1;
+
+  LoadWebsocket websocket(stats, port, "/signalk/v1/stream?subscribe=none&token=" + token);
+  LoadUdp udp(stats, udpPort);
+  EspSigKStream loadStream(udpPort > 0 ? (EspSigKTransport &)udp : (EspSigKTransport &)websocket, frameQueue, stats);
+  loadStream.setReconnectInterval(reconnectInterval);
+  loadStream.setLatency(&latency);
+  stream = &loadStream;
+  std::thread networkThread(networkLoop);
+
+  // the network thread's counters, read while it runs
+  const volatile signalKStats &network = stats;
+
+  printf("%8s %9s %8s %7s %7s %7s %8s %8s %8s %6s %10s %10s\n", "rate/s", "deltas/s", "kB/s", "drop%", "full", "offline",
+         "p50 ms", "p99 ms", "lib p99", "drops", "recov p50", "recov max");
+  for (uint32_t rate : rates) {
+    // start each step with an empty queue and fresh counters on both sides
+    while (network.deltasSent + network.deltasNotConnected + network.sendErrors < committed) delay(1);
+    httpGet(http, port, "GET", "/stats?reset", "", body);
+    latency.reset();
+    uint32_t droppedBefore = frameQueue.getDropped();
+    uint32_t notConnectedBefore = network.deltasNotConnected;
+
+    uint64_t period = 1000000 / rate;
+    uint64_t start = nowMicros();
+    uint64_t next = start;
+    uint32_t generated = 0;
+    while (nowMicros() - start < seconds * 1000000ULL) {
+      sendDelta(generated++);
+      next += period;
+      uint64_t now = nowMicros();
+      if (next > now) std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+    }
+    double duration = (nowMicros() - start) / 1e6;
+    delay(200);   // let the last frames arrive
+
+    if (httpGet(http, port, "GET", "/stats", "", body) != 200) {
+      fprintf(stderr, "sigkload: no /stats from the server\n");
+      break;
+    }
+    double received = jsonNumber(body, "deltas") + jsonNumber(body, "udpDeltas");
+    printf("%8u %9.0f %8.1f %7.2f %7u %7u %8.3f %8.3f %8.3f %6.0f %10.0f %10.0f\n",
+           (unsigned int)rate, received / duration, jsonNumber(body, "bytes") / duration / 1000,
+           generated > 0 ? 100.0 * (generated - received) / generated : 0.0,
+           (unsigned int)(frameQueue.getDropped() - droppedBefore), (unsigned int)(network.deltasNotConnected - notConnectedBefore),
+           jsonNumber(body, "latencyP50") / 1000, jsonNumber(body, "latencyP99") / 1000,
+           latency.captureToSend.getPercentile(99) / 1000.0,
+           jsonNumber(body, "drops"), jsonNumber(body, "recoveryP50"), jsonNumber(body, "recoveryMax"));
+  }
+
+  running = false;
+  notifyGive();
+  networkThread.join();
+  printf("websocket reconnects %u, longest %u ms, send errors %u, oversize %u\n",
+         (unsigned int)(stats.connects > 0 ? stats.connects - 1 : 0), (unsigned int)recoveryMax,
+         (unsigned int)stats.sendErrors, (unsigned int)stats.deltasOversize);
+  return 0;
+}
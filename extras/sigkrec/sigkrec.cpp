@@ -0,0 +1,223 @@
+/*
+ * Decodes EspSigK recorder segments (see EspSigKRecorder.h) back into
+ * Signal K deltas, one JSON delta per line on stdout.
+ *
+ * Build: g++ -std=c++11 -O2 -o sigkrec sigkrec.cpp
+ * Usage: sigkrec [-s speed] segment.rec [segment.rec ...]
+ *
+ *   -s 1    replay at the recorded rate
+ *   -s 10   replay ten times faster
+ *   -s 0    no delays (default)
+ *
+ * Segments are decoded in the order given, download them oldest first from
+ * http://<node>/signalk/recorder?segment=N. The output can be piped into a
+ * Signal K server's TCP/UDP delta input, e.g. "sigkrec -s 1 *.rec | nc -u server 8375".
+ * Assumes a little endian host, like the ESP.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define RECORD_PATH 0x01
+#define RECORD_DELTA 0x02
+#define RECORD_VALUE_INT 0x10
+#define RECORD_VALUE_DOUBLE 0x11
+#define RECORD_VALUE_FALSE 0x12
+#define RECORD_VALUE_TRUE 0x13
+#define PATH_HANDLE_NONE 0xFF       // path follows inline, the node's path table was full
+
+struct Reader {
+  const std::vector<uint8_t> &data;
+  size_t pos;
+  bool ok;
+
+  explicit Reader(const std::vector<uint8_t> &data) : data(data), pos(0), ok(true) {}
+
+  bool more() { return ok && pos < data.size(); }
+
+  uint8_t byte() {
+    if (pos >= data.size()) { ok = false; return 0; }
+    return data[pos++];
+  }
+
+  uint32_t varint() {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b = byte();
+      v |= (uint32_t)(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    ok = false;
+    return 0;
+  }
+
+  uint32_t uint32() {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= (uint32_t)byte() << (8 * i);
+    return v;
+  }
+
+  std::string string(size_t length) {
+    if (pos + length > data.size()) { ok = false; return ""; }
+    std::string s((const char *)&data[pos], length);
+    pos += length;
+    return s;
+  }
+
+  double float64() {
+    double d = 0;
+    if (pos + sizeof(d) > data.size()) { ok = false; return 0; }
+    memcpy(&d, &data[pos], sizeof(d));
+    pos += sizeof(d);
+    return d;
+  }
+};
+
+static std::string jsonString(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+static std::string isoTime(uint64_t unixMillis) {
+  char buf[32];
+  time_t seconds = (time_t)(unixMillis / 1000);
+  struct tm tm;
+  gmtime_r(&seconds, &tm);
+  size_t len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(buf + len, sizeof(buf) - len, ".%03uZ", (unsigned)(unixMillis % 1000));
+  return buf;
+}
+
+static bool readFile(const char *name, std::vector<uint8_t> &data) {
+  FILE *f = fopen(name, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  double speed = 0;
+  int first = 1;
+  if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+    speed = atof(argv[2]);
+    first = 3;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "usage: %s [-s speed] segment.rec [segment.rec ...]\n", argv[0]);
+    return 2;
+  }
+
+  bool havePrevious = false;
+  uint32_t previousMillis = 0;   // device millis() of the last delta, to carry timing across segments
+
+  for (int arg = first; arg < argc; arg++) {
+    std::vector<uint8_t> data;
+    if (!readFile(argv[arg], data)) {
+      fprintf(stderr, "%s: can't read\n", argv[arg]);
+      return 1;
+    }
+
+    Reader in(data);
+    if (in.string(4) != "SKR1") {
+      fprintf(stderr, "%s: not a recorder segment\n", argv[arg]);
+      return 1;
+    }
+    uint32_t millis = in.uint32();
+    uint32_t unixTime = in.uint32();
+    std::string source = in.string(in.varint());
+    uint32_t startMillis = millis;
+
+    // a segment started by rotation continues the previous one's clock, after a reboot there is no gap to replay
+    uint32_t gap = (havePrevious && millis >= previousMillis) ? millis - previousMillis : 0;
+
+    std::vector<std::string> paths(256);
+    while (in.more()) {
+      uint8_t record = in.byte();
+      if (record == RECORD_PATH) {
+        uint32_t handle = in.varint();
+        std::string path = in.string(in.varint());
+        if (handle < paths.size()) paths[handle] = path;
+        continue;
+      }
+      if (record != RECORD_DELTA) {
+        fprintf(stderr, "%s: unknown record 0x%02x at %zu\n", argv[arg], record, in.pos - 1);
+        break;
+      }
+
+      uint32_t dt = in.varint();
+      uint32_t count = in.varint();
+      millis += dt;
+
+      std::string values;
+      for (uint32_t i = 0; i < count && in.ok; i++) {
+        uint8_t type = in.byte();
+        uint32_t handle = in.varint();
+        std::string path;
+        if (handle == PATH_HANDLE_NONE) {
+          path = in.string(in.varint());
+        } else if (handle < paths.size()) {
+          path = paths[handle];
+        }
+        std::string value;
+        char buf[32];
+        switch (type) {
+          case RECORD_VALUE_INT: {
+            uint32_t z = in.varint();
+            snprintf(buf, sizeof(buf), "%d", (int32_t)((z >> 1) ^ (~(z & 1) + 1)));
+            value = buf;
+            break;
+          }
+          case RECORD_VALUE_DOUBLE: {
+            double d = in.float64();
+            if (std::isfinite(d)) {
+              snprintf(buf, sizeof(buf), "%.10g", d);
+              value = buf;
+            } else {
+              value = "null";
+            }
+            break;
+          }
+          case RECORD_VALUE_FALSE: value = "false"; break;
+          case RECORD_VALUE_TRUE: value = "true"; break;
+          default: in.ok = false; break;
+        }
+        if (!values.empty()) values += ",";
+        values += "{\"path\":" + jsonString(path) + ",\"value\":" + value + "}";
+      }
+      if (!in.ok) {
+        fprintf(stderr, "%s: truncated record at end of segment\n", argv[arg]);
+        break;
+      }
+
+      if (speed > 0 && havePrevious) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>((dt + gap) / speed));
+      }
+      gap = 0;
+      havePrevious = true;
+      previousMillis = millis;
+
+      std::string update = "{\"source\":{\"label\":\"ESP\",\"src\":" + jsonString(source) + "},";
+      if (unixTime != 0) {
+        update += "\"timestamp\":\"" + isoTime((uint64_t)unixTime * 1000 + (uint32_t)(millis - startMillis)) + "\",";
+      }
+      printf("{\"updates\":[%s\"values\":[%s]}]}\n", update.c_str(), values.c_str());
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,544 @@
+/*
+ * Stand-in Signal K server for testing EspSigK on a PC, loopback only.
+ *
+ *   HTTP    /signalk                         discovery
+ *           POST /signalk/v1/access/requests  access request, answered PENDING
+ *           GET /signalk/v1/requests/N        PENDING for -n polls, then APPROVED (with a token) or DENIED
+ *           GET /signalk/v1/stream            websocket upgrade, takes deltas, answers pings
+ *           GET /stats[?reset]                counters and latency of the deltas received
+ *   UDP     deltas, one per datagram (Signal K UDP input)
+ *
+ * Build: g++ -std=c++11 -O2 -o sigkstub sigkstub.cpp
+ * Usage: sigkstub [-p port] [-u udpPort] [-a approve|deny] [-n polls] [-t token]
+ *                 [-k keepalive|close|http10|chunked] [-d ms] [-v]
+ *
+ *   -p 3000       HTTP and websocket port
+ *   -u 8375       UDP port, 0 for none
+ *   -a approve    outcome of access requests
+ *   -n 2          polls answered PENDING before the outcome
+ *   -t token      token handed out on approval
+ *   -k keepalive  HTTP responses: keep-alive with Content-Length, Connection: close,
+ *                 HTTP/1.0 without a length, or chunked
+ *   -d 0          drop every websocket connection after this many ms (no close frame),
+ *                 to measure reconnects
+ *   -v            print every request and delta
+ *
+ * Latency is measured on deltas carrying the values test.sequence (counts up from 0 per
+ * sender) and test.capturedMicros (CLOCK_MONOTONIC at capture modulo 10^9 us, an int
+ * like the ESP sends, so only from this host), as extras/sigkload sends them. Gaps in test.sequence are counted as lost deltas.
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define CAPTURE_WRAP 1000000000ULL   // test.capturedMicros counts modulo this, to fit an int
+
+static uint64_t nowMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* ******************************************************************** */
+/* Websocket handshake: base64(sha1(key + GUID))                         */
+/* ******************************************************************** */
+
+static void sha1(const std::string &message, uint8_t digest[20]) {
+  uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+  std::string data = message;
+  uint64_t bits = (uint64_t)message.size() * 8;
+  data += (char)0x80;
+  while (data.size() % 64 != 56) data += (char)0;
+  for (int i = 7; i >= 0; i--) data += (char)(bits >> (i * 8));
+
+  for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const uint8_t * p = (const uint8_t *)data.data() + chunk + i * 4;
+      w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+    for (int i = 16; i < 80; i++) {
+      uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+      w[i] = (x << 1) | (x >> 31);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+      else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+      else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+      else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+      uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = (b << 30) | (b >> 2);
+      b = a;
+      a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+  }
+  for (int i = 0; i < 20; i++) digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+static std::string base64(const uint8_t * data, size_t length) {
+  static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t n = (uint32_t)data[i] << 16;
+    if (i + 1 < length) n |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < length) n |= data[i + 2];
+    out += table[(n >> 18) & 63];
+    out += table[(n >> 12) & 63];
+    out += i + 1 < length ? table[(n >> 6) & 63] : '=';
+    out += i + 2 < length ? table[n & 63] : '=';
+  }
+  return out;
+}
+
+static std::string websocketAccept(const std::string &key) {
+  uint8_t digest[20];
+  sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+  return base64(digest, sizeof(digest));
+}
+
+/* ******************************************************************** */
+/* Settings and counters                                                */
+/* ******************************************************************** */
+
+enum ResponseStyle { STYLE_KEEPALIVE, STYLE_CLOSE, STYLE_HTTP10, STYLE_CHUNKED };
+
+static uint16_t httpPort = 3000;
+static uint16_t udpPort = 8375;
+static bool approve = true;
+static int pendingPolls = 2;
+static std::string token = "stub-token";
+static ResponseStyle style = STYLE_KEEPALIVE;
+static uint32_t dropAfterMillis = 0;
+static bool verbose = false;
+
+struct AccessRequest {
+  std::string clientId;
+  int polls;
+};
+static std::vector<AccessRequest> accessRequests;
+
+struct Stats {
+  uint64_t since;
+  uint64_t deltas;
+  uint64_t udpDeltas;
+  uint64_t values;
+  uint64_t bytes;
+  uint64_t lost;              // gaps in test.sequence
+  uint64_t connects;
+  uint64_t drops;             // connections dropped with -d
+  uint64_t pings;
+  std::vector<uint32_t> latencies;    // us, capture to received
+  std::vector<uint32_t> recoveries;   // ms, drop to the first delta on the next connection
+};
+static Stats stats;
+static int64_t lastSequence = -1;
+static uint64_t droppedAt = 0;       // us, 0 when no recovery is pending
+
+static void resetStats() {
+  stats = Stats();
+  stats.since = nowMicros();
+  lastSequence = -1;
+  droppedAt = 0;
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, int percent) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t i = (values.size() * percent + 99) / 100;
+  return values[i > 0 ? i - 1 : 0];
+}
+
+// value of {"path":"<path>","value":<number>} in a delta, false if not there
+static bool findValue(const std::string &delta, const char * path, double &value) {
+  std::string key = std::string("\"path\":\"") + path + "\"";
+  size_t at = delta.find(key);
+  if (at == std::string::npos) return false;
+  at = delta.find("\"value\":", at);
+  if (at == std::string::npos) return false;
+  value = strtod(delta.c_str() + at + 8, NULL);
+  return true;
+}
+
+static void receiveDelta(const std::string &delta, bool udp) {
+  uint64_t now = nowMicros();
+  if (verbose) printf("%s delta: %s\n", udp ? "udp" : "ws", delta.c_str());
+
+  if (udp) stats.udpDeltas++; else stats.deltas++;
+  stats.bytes += delta.size();
+  for (size_t at = 0; (at = delta.find("\"path\":", at)) != std::string::npos; at++) stats.values++;
+
+  double sequence, captured;
+  if (findValue(delta, "test.sequence", sequence)) {
+    if (sequence == 0) lastSequence = -1;    // a new sender
+    if ((int64_t)sequence > lastSequence + 1) stats.lost += (int64_t)sequence - lastSequence - 1;
+    lastSequence = (int64_t)sequence;
+  }
+  if (findValue(delta, "test.capturedMicros", captured) && captured >= 0 && captured < CAPTURE_WRAP) {
+    stats.latencies.push_back((uint32_t)((now % CAPTURE_WRAP + CAPTURE_WRAP - (uint64_t)captured) % CAPTURE_WRAP));
+  }
+  if (droppedAt != 0) {
+    stats.recoveries.push_back((uint32_t)((now - droppedAt) / 1000));
+    droppedAt = 0;
+  }
+}
+
+static std::string statsJson() {
+  char json[512];
+  double seconds = (nowMicros() - stats.since) / 1e6;
+  snprintf(json, sizeof(json),
+           "{\"seconds\":%.3f,\"deltas\":%llu,\"udpDeltas\":%llu,\"values\":%llu,\"bytes\":%llu,\"lost\":%llu,"
+           "\"connects\":%llu,\"drops\":%llu,\"pings\":%llu,\"latencyP50\":%u,\"latencyP99\":%u,\"latencyMax\":%u,"
+           "\"recoveries\":%u,\"recoveryP50\":%u,\"recoveryMax\":%u}",
+           seconds, (unsigned long long)stats.deltas, (unsigned long long)stats.udpDeltas,
+           (unsigned long long)stats.values, (unsigned long long)stats.bytes, (unsigned long long)stats.lost,
+           (unsigned long long)stats.connects, (unsigned long long)stats.drops, (unsigned long long)stats.pings,
+           percentile(stats.latencies, 50), percentile(stats.latencies, 99), percentile(stats.latencies, 100),
+           (unsigned int)stats.recoveries.size(), percentile(stats.recoveries, 50), percentile(stats.recoveries, 100));
+  return json;
+}
+
+/* ******************************************************************** */
+/* Connections                                                          */
+/* ******************************************************************** */
+
+struct Connection {
+  int fd;
+  std::string in;
+  std::string out;
+  bool websocket;
+  bool closeAfterWrite;
+  uint64_t openedAt;      // us, websocket upgrade
+};
+static std::vector<Connection> connections;
+
+static void sendResponse(Connection &c, int status, const char * reason, const std::string &body,
+                         const char * contentType = "application/json") {
+  char head[256];
+  switch (style) {
+    case STYLE_KEEPALIVE:
+    case STYLE_CLOSE:
+      snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s\r\n",
+               status, reason, contentType, (unsigned int)body.size(), style == STYLE_CLOSE ? "Connection: close\r\n" : "");
+      c.out += head;
+      c.out += body;
+      c.closeAfterWrite = (style == STYLE_CLOSE);
+      break;
+    case STYLE_HTTP10:
+      snprintf(head, sizeof(head), "HTTP/1.0 %d %s\r\nContent-Type: %s\r\n\r\n", status, reason, contentType);
+      c.out += head;
+      c.out += body;
+      c.closeAfterWrite = true;
+      break;
+    case STYLE_CHUNKED: {
+      snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n\r\n",
+               status, reason, contentType);
+      c.out += head;
+      // in two chunks, so the client has to put them together
+      size_t half = body.size() / 2;
+      const std::string parts[2] = { body.substr(0, half), body.substr(half) };
+      for (const std::string &part : parts) {
+        if (part.empty()) continue;
+        char size[16];
+        snprintf(size, sizeof(size), "%x\r\n", (unsigned int)part.size());
+        c.out += size + part + "\r\n";
+      }
+      c.out += "0\r\n\r\n";
+      break;
+    }
+  }
+}
+
+static std::string header(const std::string &head, const char * name) {
+  size_t at = 0;
+  size_t nameLength = strlen(name);
+  while ((at = head.find("\r\n", at)) != std::string::npos) {
+    at += 2;
+    if (strncasecmp(head.c_str() + at, name, nameLength) == 0 && head[at + nameLength] == ':') {
+      size_t start = head.find_first_not_of(" \t", at + nameLength + 1);
+      size_t end = head.find("\r\n", at);
+      return head.substr(start, end - start);
+    }
+  }
+  return "";
+}
+
+static void handleRequest(Connection &c, const std::string &head, const std::string &body) {
+  char method[8] = "", path[256] = "";
+  sscanf(head.c_str(), "%7s %255s", method, path);
+  if (verbose) printf("%s %s %s\n", method, path, body.c_str());
+  std::string target = path;
+
+  if (strcmp(method, "GET") == 0 && (target == "/signalk" || target == "/signalk/")) {
+    char json[256];
+    snprintf(json, sizeof(json), "{\"endpoints\":{\"v1\":{\"version\":\"1.0.0\",\"signalk-http\":\"http://127.0.0.1:%u/signalk/v1/api/\","
+             "\"signalk-ws\":\"ws://127.0.0.1:%u/signalk/v1/stream\"}},\"server\":{\"id\":\"sigkstub\",\"version\":\"0.1.0\"}}",
+             httpPort, httpPort);
+    sendResponse(c, 200, "OK", json);
+
+  } else if (strcmp(method, "POST") == 0 && target == "/signalk/v1/access/requests") {
+    size_t at = body.find("\"clientId\":\"");
+    if (at == std::string::npos) {
+      sendResponse(c, 400, "Bad Request", "{\"message\":\"clientId missing\"}");
+      return;
+    }
+    at += 12;
+    accessRequests.push_back({ body.substr(at, body.find('"', at) - at), 0 });
+    char json[160];
+    snprintf(json, sizeof(json), "{\"state\":\"PENDING\",\"requestId\":\"%u\",\"href\":\"/signalk/v1/requests/%u\"}",
+             (unsigned int)accessRequests.size(), (unsigned int)accessRequests.size());
+    sendResponse(c, 202, "Accepted", json);
+
+  } else if (strcmp(method, "GET") == 0 && target.compare(0, 21, "/signalk/v1/requests/") == 0) {
+    size_t id = strtoul(path + 21, NULL, 10);
+    if (id < 1 || id > accessRequests.size()) {
+      sendResponse(c, 404, "Not Found", "{\"message\":\"no such request\"}");
+      return;
+    }
+    AccessRequest &request = accessRequests[id - 1];
+    std::string json;
+    char prefix[160];
+    snprintf(prefix, sizeof(prefix), "{\"requestId\":\"%u\",\"href\":\"/signalk/v1/requests/%u\",",
+             (unsigned int)id, (unsigned int)id);
+    if (request.polls++ < pendingPolls) {
+      json = std::string(prefix) + "\"state\":\"PENDING\"}";
+    } else if (approve) {
+      json = std::string(prefix) + "\"state\":\"COMPLETED\",\"statusCode\":200,\"accessRequest\":{\"permission\":\"APPROVED\","
+             "\"token\":\"" + token + "\",\"expirationTime\":\"2099-01-01T00:00:00.000Z\"},\"ip\":\"127.0.0.1\"}";
+    } else {
+      json = std::string(prefix) + "\"state\":\"COMPLETED\",\"statusCode\":200,\"accessRequest\":{\"permission\":\"DENIED\"}}";
+    }
+    sendResponse(c, 200, "OK", json);
+
+  } else if (strcmp(method, "GET") == 0 && target.compare(0, 18, "/signalk/v1/stream") == 0) {
+    std::string key = header(head, "Sec-WebSocket-Key");
+    if (key.empty() || strcasecmp(header(head, "Upgrade").c_str(), "websocket") != 0) {
+      sendResponse(c, 400, "Bad Request", "{\"message\":\"websocket upgrade expected\"}");
+      return;
+    }
+    size_t at = target.find("token=");
+    if (at != std::string::npos && target.compare(at + 6, std::string::npos, token) != 0) {
+      sendResponse(c, 401, "Unauthorized", "{\"message\":\"bad token\"}");
+      return;
+    }
+    c.out += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+             "Sec-WebSocket-Accept: " + websocketAccept(key) + "\r\n\r\n";
+    c.websocket = true;
+    c.openedAt = nowMicros();
+    stats.connects++;
+    // the hello a Signal K server sends first
+    std::string hello = "{\"name\":\"sigkstub\",\"version\":\"0.1.0\",\"self\":\"vessels.urn:mrn:signalk:uuid:stub\",\"roles\":[\"master\"]}";
+    c.out += (char)0x81;
+    c.out += (char)hello.size();
+    c.out += hello;
+
+  } else if (strcmp(method, "GET") == 0 && target.compare(0, 6, "/stats") == 0) {
+    std::string json = statsJson();
+    if (target.find("reset") != std::string::npos) resetStats();
+    sendResponse(c, 200, "OK", json);
+
+  } else {
+    sendResponse(c, 404, "Not Found", "{\"message\":\"not found\"}");
+  }
+}
+
+static void websocketSend(Connection &c, uint8_t opcode, const std::string &payload) {
+  c.out += (char)(0x80 | opcode);
+  if (payload.size() < 126) {
+    c.out += (char)payload.size();
+  } else {
+    c.out += (char)126;
+    c.out += (char)(payload.size() >> 8);
+    c.out += (char)(payload.size() & 0xFF);
+  }
+  c.out += payload;
+}
+
+// Handles the complete frames in c.in. Returns false when the connection should close.
+static bool handleWebsocket(Connection &c) {
+  while (c.in.size() >= 2) {
+    const uint8_t * p = (const uint8_t *)c.in.data();
+    uint8_t opcode = p[0] & 0x0F;
+    bool masked = p[1] & 0x80;
+    uint64_t length = p[1] & 0x7F;
+    size_t at = 2;
+    if (length == 126) {
+      if (c.in.size() < 4) return true;
+      length = (uint64_t)p[2] << 8 | p[3];
+      at = 4;
+    } else if (length == 127) {
+      if (c.in.size() < 10) return true;
+      length = 0;
+      for (int i = 0; i < 8; i++) length = length << 8 | p[2 + i];
+      at = 10;
+    }
+    if (!masked) return false; // clients must mask
+    if (c.in.size() < at + 4 + length) return true;
+
+    std::string payload = c.in.substr(at + 4, length);
+    for (size_t i = 0; i < payload.size(); i++) payload[i] ^= p[at + i % 4];
+    c.in.erase(0, at + 4 + length);
+
+    switch (opcode) {
+      case 0x1: receiveDelta(payload, false); break;       // text
+      case 0x8: websocketSend(c, 0x8, payload.substr(0, 2)); c.closeAfterWrite = true; return true;
+      case 0x9: stats.pings++; websocketSend(c, 0xA, payload); break;
+      default: break;                                       // binary, pong, continuation: ignored
+    }
+  }
+  return true;
+}
+
+// Handles the complete requests in c.in. Returns false when the connection should close.
+static bool handleHttp(Connection &c) {
+  while (!c.websocket) {
+    size_t end = c.in.find("\r\n\r\n");
+    if (end == std::string::npos) return c.in.size() < 8192;
+    std::string head = c.in.substr(0, end + 2);
+    size_t bodyLength = strtoul(header(head, "Content-Length").c_str(), NULL, 10);
+    if (c.in.size() < end + 4 + bodyLength) return true;
+    std::string body = c.in.substr(end + 4, bodyLength);
+    c.in.erase(0, end + 4 + bodyLength);
+    handleRequest(c, head, body);
+    if (c.closeAfterWrite) return true;
+  }
+  return handleWebsocket(c);
+}
+
+static int listenOn(int type, uint16_t port) {
+  int fd = socket(AF_INET, type, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || (type == SOCK_STREAM && listen(fd, 8) != 0)) {
+    fprintf(stderr, "sigkstub: can't listen on 127.0.0.1:%u: %s\n", port, strerror(errno));
+    exit(1);
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: sigkstub [-p port] [-u udpPort] [-a approve|deny] [-n polls] [-t token]\n"
+                  "                [-k keepalive|close|http10|chunked] [-d ms] [-v]\n");
+  exit(2);
+}
+
+int main(int argc, char ** argv) {
+  int option;
+  while ((option = getopt(argc, argv, "p:u:a:n:t:k:d:v")) != -1) {
+    switch (option) {
+      case 'p': httpPort = atoi(optarg); break;
+      case 'u': udpPort = atoi(optarg); break;
+      case 'a': approve = strcmp(optarg, "deny") != 0; break;
+      case 'n': pendingPolls = atoi(optarg); break;
+      case 't': token = optarg; break;
+      case 'k':
+        if (strcmp(optarg, "keepalive") == 0) style = STYLE_KEEPALIVE;
+        else if (strcmp(optarg, "close") == 0) style = STYLE_CLOSE;
+        else if (strcmp(optarg, "http10") == 0) style = STYLE_HTTP10;
+        else if (strcmp(optarg, "chunked") == 0) style = STYLE_CHUNKED;
+        else usage();
+        break;
+      case 'd': dropAfterMillis = atoi(optarg); break;
+      case 'v': verbose = true; break;
+      default: usage();
+    }
+  }
+  signal(SIGPIPE, SIG_IGN);
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  int listener = listenOn(SOCK_STREAM, httpPort);
+  int udp = udpPort > 0 ? listenOn(SOCK_DGRAM, udpPort) : -1;
+  printf("sigkstub on 127.0.0.1:%u, UDP %u, access requests %s after %d polls\n",
+         httpPort, udpPort, approve ? "approved" : "denied", pendingPolls);
+  resetStats();
+
+  while (true) {
+    std::vector<struct pollfd> fds;
+    fds.push_back({ listener, POLLIN, 0 });
+    fds.push_back({ udp, POLLIN, 0 });
+    for (Connection &c : connections) {
+      fds.push_back({ c.fd, (short)(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0 });
+    }
+    poll(fds.data(), fds.size(), 10);
+
+    if (udp >= 0 && (fds[1].revents & POLLIN)) {
+      char datagram[65536];
+      ssize_t n;
+      while ((n = recv(udp, datagram, sizeof(datagram), 0)) > 0) {
+        receiveDelta(std::string(datagram, n), true);
+      }
+    }
+
+    // fds[2..] line up with connections until one is closed, so walk both together
+    for (size_t i = 0, slot = 2; i < connections.size(); slot++) {
+      Connection &c = connections[i];
+      bool open = true;
+      short revents = fds[slot].revents;
+
+      if (revents & (POLLIN | POLLHUP | POLLERR)) {
+        char buffer[16384];
+        ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+          c.in.append(buffer, n);
+          open = handleHttp(c);
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+          open = false;
+        }
+      }
+      if (open && !c.out.empty()) {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n > 0) c.out.erase(0, n);
+        else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) open = false;
+      }
+      if (open && c.closeAfterWrite && c.out.empty()) open = false;
+      uint64_t now = nowMicros();
+      if (open && c.websocket && dropAfterMillis > 0 && now - c.openedAt >= dropAfterMillis * 1000ULL) {
+        // like a server restart or a WiFi drop, no close frame
+        stats.drops++;
+        droppedAt = now;
+        open = false;
+      }
+      if (!open) {
+        close(c.fd);
+        connections.erase(connections.begin() + i);
+      } else {
+        i++;
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listener, NULL, NULL);
+      if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        connections.push_back({ fd, "", "", false, false, 0 });
+      }
+    }
+  }
+}
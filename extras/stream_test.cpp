@@ -0,0 +1,190 @@
+/*
+ * Host test of EspSigKStream and the delta serializer against a scripted transport:
+ * the JSON sendDelta() produces, oversize deltas, sending and counting, the reconnect
+ * timer and each way a connection is lost. Time only moves in delay().
+ *
+ * Build: g++ -std=c++11 -O2 -I host -I .. -o stream_test stream_test.cpp ../EspSigKDelta.cpp ../EspSigKStream.cpp
+ * Usage: stream_test     (exit status 0 when all checks pass)
+ */
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "EspSigKStream.h"
+
+static unsigned long fakeMillis = 0;
+unsigned long millis() { return fakeMillis; }
+unsigned long micros() { return fakeMillis * 1000; }
+void delay(unsigned long ms) { fakeMillis += ms; }
+
+class ScriptedTransport : public EspSigKTransport
+{
+  public:
+    bool connect() { connects++; open = accept; return open; }
+    bool available() { return open; }
+    void poll() { polls++; }
+    bool send(const char * frame, size_t length) {
+      if (failSends) {
+        open = false;     // the socket went away under the send
+        return false;
+      }
+      sent.push_back(std::string(frame, length));
+      return true;
+    }
+    void close() { open = false; closes++; }
+    void connected() { connectedCalls++; }
+    void lost() { lostCalls++; }
+
+    bool accept = true;
+    bool open = false;
+    bool failSends = false;
+    int connects = 0, polls = 0, closes = 0, connectedCalls = 0, lostCalls = 0;
+    std::vector<std::string> sent;
+};
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } \
+  } while (0)
+
+static void setValue(deltaValue &v, int i) { v.pathHandle = PATH_HANDLE_NONE; v.type = DELTA_VALUE_INT; v.i = i; }
+static void setValue(deltaValue &v, double d) { v.pathHandle = PATH_HANDLE_NONE; v.type = DELTA_VALUE_DOUBLE; v.d = d; }
+static void setValue(deltaValue &v, bool b) { v.pathHandle = PATH_HANDLE_NONE; v.type = DELTA_VALUE_BOOL; v.b = b; }
+
+static void testSerialize() {
+  char paths[4][MAX_DELTA_PATH_LENGTH] = { "navigation.speedOverGround", "a.\"quoted\"\\path", "tab\there", "b" };
+  deltaValue values[4];
+  char frame[DELTA_FRAME_SIZE];
+  setValue(values[0], 3.25);
+  setValue(values[1], -42);
+  setValue(values[2], true);
+  setValue(values[3], (double)NAN);
+
+  size_t length = serializeDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 4, frame, sizeof(frame));
+  CHECK(std::string(frame, length) ==
+        "{\"updates\":[{\"source\":{\"label\":\"ESP\",\"src\":\"node\"},\"values\":["
+        "{\"path\":\"navigation.speedOverGround\",\"value\":3.25},"
+        "{\"path\":\"a.\\\"quoted\\\"\\\\path\",\"value\":-42},"
+        "{\"path\":\"tab\\u0009here\",\"value\":true},"
+        "{\"path\":\"b\",\"value\":null}]}]}");
+
+  // exactly fitting, and one byte short
+  CHECK(serializeDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 4, frame, length) == length);
+  CHECK(serializeDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 4, frame, length - 1) == 0);
+
+  // the worst case DELTA_FRAME_SIZE is sized for fits
+  char longPaths[MAX_DELTA_VALUES][MAX_DELTA_PATH_LENGTH];
+  deltaValue longValues[MAX_DELTA_VALUES];
+  char source[MAX_HOSTNAME_LENGTH + 1];
+  memset(source, 'h', MAX_HOSTNAME_LENGTH);
+  source[MAX_HOSTNAME_LENGTH] = '\0';
+  for (uint8_t i = 0; i < MAX_DELTA_VALUES; i++) {
+    memset(longPaths[i], 'p', MAX_DELTA_PATH_LENGTH - 1);
+    longPaths[i][MAX_DELTA_PATH_LENGTH - 1] = '\0';
+    setValue(longValues[i], -1.234567891e-100);
+  }
+  CHECK(serializeDelta(source, longValues, longPaths[0], MAX_DELTA_PATH_LENGTH, MAX_DELTA_VALUES, frame, sizeof(frame)) > 0);
+}
+
+static void testQueueAndSend() {
+  ScriptedTransport transport;
+  EspSigKStaticFrameQueue<> queue;
+  signalKStats stats;
+  memset(&stats, 0, sizeof(stats));
+  EspSigKStream stream(transport, queue, stats);
+  char paths[1][MAX_DELTA_PATH_LENGTH] = { "a.b" };
+  deltaValue values[1];
+  setValue(values[0], 1);
+
+  // not connected: queued, then counted as not sent
+  CHECK(stream.queueDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 1, 0) > 0);
+  stream.sendQueuedFrames();
+  CHECK(stats.deltasNotConnected == 1 && transport.sent.empty());
+
+  CHECK(stream.connect());
+  CHECK(stats.connects == 1 && transport.connectedCalls == 1 && stream.isConnected());
+  size_t length = stream.queueDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 1, 0);
+  CHECK(length > 0 && std::string(stream.lastFrame(), length) == "{\"updates\":[{\"source\":{\"label\":\"ESP\",\"src\":\"node\"},\"values\":[{\"path\":\"a.b\",\"value\":1}]}]}");
+  stream.handle();
+  CHECK(stats.deltasSent == 1 && stats.bytesSent == length && transport.sent.size() == 1 && transport.polls == 1);
+
+  // larger than DELTA_FRAME_SIZE: dropped and counted, the queue slot stays free
+  char source[DELTA_FRAME_SIZE];
+  memset(source, 's', sizeof(source) - 1);
+  source[sizeof(source) - 1] = '\0';
+  CHECK(stream.queueDelta(source, values, paths[0], MAX_DELTA_PATH_LENGTH, 1, 0) == 0);
+  CHECK(stats.deltasOversize == 1 && queue.getDropped() == 0);
+
+  // queue full: dropped and counted by the queue
+  for (uint8_t i = 0; i < FRAME_QUEUE_DEPTH; i++) stream.queueDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 1, 0);
+  CHECK(stream.queueDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 1, 0) == 0);
+  CHECK(queue.getDropped() == 1);
+  stream.sendQueuedFrames();
+  CHECK(stats.deltasSent == 1 + FRAME_QUEUE_DEPTH);
+}
+
+static void testLossAndReconnect() {
+  ScriptedTransport transport;
+  EspSigKStaticFrameQueue<> queue;
+  signalKStats stats;
+  memset(&stats, 0, sizeof(stats));
+  EspSigKStream stream(transport, queue, stats);
+  stream.setReconnectInterval(1000);
+  char paths[1][MAX_DELTA_PATH_LENGTH] = { "a.b" };
+  deltaValue values[1];
+  setValue(values[0], false);
+
+  stream.connect();
+
+  // the server went away: noticed before the next poll
+  transport.open = false;
+  stream.handle();
+  CHECK(!stream.isConnected() && stats.disconnects == 1 && transport.lostCalls == 1 && transport.closes == 1);
+
+  // the reconnect timer brings it back, counting how long it took
+  delay(400);
+  stream.handle();
+  CHECK(!stream.isConnected() && transport.connects == 1);
+  delay(600);
+  stream.handle();
+  CHECK(stream.isConnected() && transport.connects == 2 && stats.connects == 2 && stats.lastReconnectTime == 1000);
+
+  // a send failing on a socket that is gone ends the connection
+  transport.failSends = true;
+  stream.queueDelta("node", values, paths[0], MAX_DELTA_PATH_LENGTH, 1, 0);
+  stream.sendQueuedFrames();
+  CHECK(stats.sendErrors == 1 && !stream.isConnected() && stats.disconnects == 2);
+
+  // closed() from the transport (close frame) only counts once
+  transport.failSends = false;
+  delay(1000);
+  stream.handle();
+  CHECK(stream.isConnected());
+  stream.closed();
+  stream.closed();
+  CHECK(stats.disconnects == 3 && transport.lostCalls == 3);
+
+  // refused connections are retried once per interval
+  transport.accept = false;
+  int connects = transport.connects;
+  for (int i = 0; i < 10; i++) {
+    delay(100);
+    stream.handle();
+  }
+  CHECK(transport.connects == connects + 1 && !stream.isConnected());
+}
+
+int main() {
+  testSerialize();
+  testQueueAndSend();
+  testLossAndReconnect();
+
+  if (failures > 0) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}